@@ -63,11 +63,14 @@ import snd.komelia.image.AndroidPanelDetector
 import snd.komelia.image.AndroidReaderImageFactory
 import snd.komelia.image.KomeliaImageDecoder
 import snd.komelia.image.KomeliaPanelDetector
+import snd.komelia.image.KomeliaThumbnailStore
 import snd.komelia.image.KomeliaUpscaler
 import snd.komelia.image.ReaderImageFactory
 import snd.komelia.image.UpsamplingMode
+import snd.komelia.image.VipsBackedThumbnailStore
 import snd.komelia.image.VipsImageDecoder
 import snd.komelia.image.VipsSharedLibrariesLoader
+import snd.komelia.image.VipsThumbnailStore
 import snd.komelia.image.processing.ImageProcessingPipeline
 import snd.komelia.offline.AndroidOfflineModule
 import snd.komelia.offline.OfflineModule
@@ -331,6 +334,13 @@ class AndroidAppModule(
         return Path(context.cacheDir.resolve("komelia_reader_cache").toString())
     }
 
+    override fun createThumbnailStore(): KomeliaThumbnailStore? {
+        return runCatching { VipsThumbnailStore.open(context.cacheDir.resolve("komelia_thumbnails").toString()) }
+            .onFailure { logger.error(it) { "Couldn't open thumbnail store" } }
+            .getOrNull()
+            ?.let { VipsBackedThumbnailStore(it) }
+    }
+
     override fun createOfflineModule(
         repositories: OfflineRepositories,
         onlineUser: StateFlow<KomgaUser?>,
@@ -62,12 +62,15 @@ import snd.komelia.image.DesktopPanelDetector
 import snd.komelia.image.DesktopReaderImageFactory
 import snd.komelia.image.KomeliaImageDecoder
 import snd.komelia.image.KomeliaPanelDetector
+import snd.komelia.image.KomeliaThumbnailStore
 import snd.komelia.image.KomeliaUpscaler
 import snd.komelia.image.ReaderImageFactory
 import snd.komelia.image.SkiaBitmap
 import snd.komelia.image.UpsamplingMode
+import snd.komelia.image.VipsBackedThumbnailStore
 import snd.komelia.image.VipsImageDecoder
 import snd.komelia.image.VipsSharedLibraries
+import snd.komelia.image.VipsThumbnailStore
 import snd.komelia.image.processing.ImageProcessingPipeline
 import snd.komelia.offline.DesktopOfflineModule
 import snd.komelia.offline.OfflineModule
@@ -101,6 +104,12 @@ import kotlin.time.measureTime
 
 private val logger = KotlinLogging.logger { }
 
+// upscaler and panel detector sessions run at the same time while reading.
+// Split cores between their intra op pools instead of letting each pool spawn a thread per core
+private val availableCores = Runtime.getRuntime().availableProcessors()
+private val panelDetectorIntraOpThreads = (availableCores / 4).coerceAtLeast(1)
+private val upscalerIntraOpThreads = (availableCores - panelDetectorIntraOpThreads).coerceAtLeast(1)
+
 class DesktopAppModule(
     private val windowState: AwtWindowState
 ) : AppModule() {
@@ -301,6 +310,9 @@ class DesktopAppModule(
         settings: ImageReaderSettingsRepository,
     ): KomeliaUpscaler {
         val upscaler = JvmOnnxRuntimeUpscaler.create(onnxRuntime as JvmOnnxRuntime)
+        upscaler.setThreadCount(upscalerIntraOpThreads, 0)
+        // upscaled pages can take hundreds of megabytes, keep them out of process memory
+        upscaler.setDiskOutput(true)
         return DesktopOnnxRuntimeUpscaler(
             settingsRepository = settings,
             executionProvider = OnnxRuntimeSharedLibraries.executionProvider,
@@ -318,6 +330,7 @@ class DesktopAppModule(
         settings: ImageReaderSettingsRepository,
     ): KomeliaPanelDetector {
         val rfDetr = JvmOnnxRuntimeRfDetr.create(onnxRuntime as JvmOnnxRuntime)
+        rfDetr.setThreadCount(panelDetectorIntraOpThreads, 0)
         val provider = when (OnnxRuntimeSharedLibraries.executionProvider) {
             TENSOR_RT -> CUDA // TRT is broken. fallback to cuda
             DirectML -> CPU // DirectML is broken. fallback to cpu
@@ -349,6 +362,13 @@ class DesktopAppModule(
         return Path(AppDirectories.readerCachePath.toString())
     }
 
+    override fun createThumbnailStore(): KomeliaThumbnailStore? {
+        return runCatching { VipsThumbnailStore.open(AppDirectories.thumbnailStorePath.toString()) }
+            .onFailure { logger.error(it) { "Couldn't open thumbnail store" } }
+            .getOrNull()
+            ?.let { VipsBackedThumbnailStore(it) }
+    }
+
     override fun createOfflineModule(
         repositories: OfflineRepositories,
         onlineUser: StateFlow<KomgaUser?>,
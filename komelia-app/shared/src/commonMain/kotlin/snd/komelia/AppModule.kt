@@ -7,7 +7,9 @@ import coil3.disk.DiskCache
 import coil3.memory.MemoryCache
 import io.github.oshai.kotlinlogging.KotlinLogging
 import io.ktor.client.*
+import io.ktor.client.plugins.*
 import io.ktor.client.plugins.contentnegotiation.*
+import io.ktor.client.plugins.cookies.*
 import io.ktor.http.*
 import io.ktor.serialization.kotlinx.json.*
 import kotlinx.coroutines.CoroutineScope
@@ -40,6 +42,7 @@ import snd.komelia.http.RememberMePersistingCookieStore
 import snd.komelia.image.BookImageLoader
 import snd.komelia.image.KomeliaImageDecoder
 import snd.komelia.image.KomeliaPanelDetector
+import snd.komelia.image.KomeliaThumbnailStore
 import snd.komelia.image.KomeliaUpscaler
 import snd.komelia.image.ReaderImageFactory
 import snd.komelia.image.coil.CoilAwareDecoder
@@ -110,6 +113,12 @@ abstract class AppModule {
             .cookieStorage(cookiesStorage)
             .build()
 
+        // uncached client for reader page downloads that are decoded while the response is still arriving
+        val pageKtor = ktorWithoutCache.config {
+            install(HttpCookies) { storage = cookiesStorage }
+            defaultRequest { url(baseUrl.value.removeSuffix("/") + "/") }
+        }
+
         val komfClientFactory = KomfClientFactory.Builder()
             .baseUrl { komfUrl.value }
             .ktor(ktor)
@@ -139,6 +148,7 @@ abstract class AppModule {
             if (offline && offlineModule != null) offlineModule.komgaApi
             else createRemoteApi(
                 komgaClientFactory = komgaClientFactory,
+                pageKtor = pageKtor,
                 offlineRepositories = offlineRepositories,
                 offlineEvents = offlineModule?.komgaEvents
             )
@@ -148,6 +158,7 @@ abstract class AppModule {
             if (offline && offlineModule!=null) offlineModule.komgaApi
             else createRemoteApi(
                 komgaClientFactory = komgaClientFactoryNoCache,
+                pageKtor = pageKtor,
                 offlineRepositories = offlineRepositories,
                 offlineEvents = offlineModule?.komgaEvents
             )
@@ -190,6 +201,7 @@ abstract class AppModule {
             komgaApi = komgaApi,
             context = androidContext,
             decoder = imageDecoder,
+            thumbnailStore = createThumbnailStore(),
         )
 
         val komgaEvents = ManagedKomgaEvents(
@@ -245,6 +257,7 @@ abstract class AppModule {
 
     protected fun createRemoteApi(
         komgaClientFactory: KomgaClientFactory,
+        pageKtor: HttpClient,
         offlineRepositories: OfflineRepositories?,
         offlineEvents: SharedFlow<KomgaEvent>?,
     ) = RemoteApi(
@@ -252,6 +265,7 @@ abstract class AppModule {
         announcementsApi = RemoteAnnouncementsApi(komgaClientFactory.announcementClient()),
         bookApi = RemoteBookApi(
             bookClient = komgaClientFactory.bookClient(),
+            pageKtor = pageKtor,
             offlineBookRepository = offlineRepositories?.bookRepository
         ),
         collectionsApi = RemoteCollectionsApi(komgaClientFactory.collectionClient()),
@@ -274,6 +288,7 @@ abstract class AppModule {
         komgaApi: StateFlow<KomgaApi>,
         context: PlatformContext,
         decoder: KomeliaImageDecoder,
+        thumbnailStore: KomeliaThumbnailStore?,
     ): ImageLoader {
 
         val timed = measureTimedValue {
@@ -284,7 +299,7 @@ abstract class AppModule {
                     .build()
             }
             diskCache?.clear()
-            val coilAwareDecoder = CoilAwareDecoder(decoder)
+            val coilAwareDecoder = CoilAwareDecoder(decoder, thumbnailStore)
 
             ImageLoader.Builder(context)
                 .components {
@@ -366,6 +381,7 @@ abstract class AppModule {
     protected abstract fun getCoilCacheDirectory(): Path?
     protected abstract fun createCoilMemoryCache(): MemoryCache?
     protected abstract fun getReaderCacheDirectory(): Path?
+    protected abstract fun createThumbnailStore(): KomeliaThumbnailStore?
 
     protected abstract fun createOfflineModule(
         repositories: OfflineRepositories,
@@ -22,6 +22,7 @@ import snd.komelia.db.settings.LocalStorageSettingsRepository
 import snd.komelia.db.settings.NoopFontsRepository
 import snd.komelia.image.KomeliaImageDecoder
 import snd.komelia.image.KomeliaPanelDetector
+import snd.komelia.image.KomeliaThumbnailStore
 import snd.komelia.image.KomeliaUpscaler
 import snd.komelia.image.ReaderImageFactory
 import snd.komelia.image.WasmReaderImageFactory
@@ -187,6 +188,8 @@ class WasmAppModule(
         return null
     }
 
+    override fun createThumbnailStore(): KomeliaThumbnailStore? = null
+
     override fun createOfflineModule(
         repositories: OfflineRepositories,
         onlineUser: StateFlow<KomgaUser?>,
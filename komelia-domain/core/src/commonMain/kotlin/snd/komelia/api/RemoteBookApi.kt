@@ -1,5 +1,9 @@
 package snd.komelia.api
 
+import io.ktor.client.HttpClient
+import io.ktor.client.request.prepareGet
+import io.ktor.client.statement.bodyAsChannel
+import io.ktor.utils.io.ByteReadChannel
 import snd.komelia.komga.api.KomgaBookApi
 import snd.komelia.komga.api.model.KomeliaBook
 import snd.komelia.offline.book.repository.OfflineBookRepository
@@ -23,6 +27,7 @@ import snd.komga.client.search.BookConditionBuilder
 
 class RemoteBookApi(
     private val bookClient: KomgaBookClient,
+    private val pageKtor: HttpClient,
     private val offlineBookRepository: OfflineBookRepository?,
 ) : KomgaBookApi {
     override suspend fun getOne(bookId: KomgaBookId): KomeliaBook {
@@ -161,6 +166,15 @@ class RemoteBookApi(
         return bookClient.getPage(bookId, page)
     }
 
+    override suspend fun <T> streamPage(
+        bookId: KomgaBookId,
+        page: Int,
+        block: suspend (ByteReadChannel) -> T
+    ): T {
+        return pageKtor.prepareGet("api/v1/books/${bookId.value}/pages/$page")
+            .execute { response -> block(response.bodyAsChannel()) }
+    }
+
     override suspend fun getPageThumbnail(
         bookId: KomgaBookId,
         page: Int
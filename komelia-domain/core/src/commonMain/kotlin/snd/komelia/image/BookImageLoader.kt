@@ -2,9 +2,16 @@ package snd.komelia.image
 
 import coil3.disk.DiskCache
 import io.github.oshai.kotlinlogging.KotlinLogging
+import kotlinx.coroutines.CancellationException
+import kotlinx.coroutines.CompletableDeferred
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.SupervisorJob
 import kotlinx.coroutines.currentCoroutineContext
 import kotlinx.coroutines.ensureActive
 import kotlinx.coroutines.flow.StateFlow
+import kotlinx.coroutines.launch
+import kotlinx.io.RawSource
 import okio.FileSystem
 import okio.Path.Companion.toPath
 import snd.komelia.komga.api.KomgaBookApi
@@ -19,11 +26,13 @@ class BookImageLoader(
     //TODO consider non coil disk cache implementation?
     val diskCache: DiskCache?,
 ) {
-    val fileSystem = diskCache?.fileSystem
+    // page responses stay open here until decoder closes the stream
+    private val downloadScope = CoroutineScope(Dispatchers.Default + SupervisorJob())
 
     suspend fun loadReaderImage(bookId: KomgaBookId, page: Int): ReaderImageResult {
         return try {
-            val source = doLoad(bookId, page)
+            val source = if (imageDecoder.supportsStreamDecode) streamLoad(bookId, page)
+            else doLoad(bookId, page)
             ReaderImageResult.Success(readerImageFactory.getImage(source, ReaderImage.PageId(bookId.value, page)))
         } catch (e: Throwable) {
             currentCoroutineContext().ensureActive()
@@ -37,12 +46,14 @@ class BookImageLoader(
         return try {
             doLoad(bookId, page).use { source ->
                 val image = when (source) {
+                    // decoded image is lazy and snapshot is closed right after, read file contents while it's still locked
                     is ImageSource.FilePathSource -> {
-                        val fileSystem = checkNotNull(fileSystem)
+                        val fileSystem = checkNotNull(diskCache).fileSystem
                         imageDecoder.decode(fileSystem.read(source.path.toPath()) { readByteArray() })
                     }
 
                     is ImageSource.MemorySource -> imageDecoder.decode(source.data)
+                    is ImageSource.StreamSource -> imageDecoder.decodeFromStream(checkNotNull(source.takeStream()))
                 }
                 ImageResult.Success(image)
             }
@@ -53,6 +64,71 @@ class BookImageLoader(
         }
     }
 
+    /**
+     * Reads sizes of pages that are already present in disk cache from image headers without decoding them.
+     * Pages that are not cached or couldn't be read are not included in the result
+     */
+    suspend fun getCachedPageSizes(bookId: KomgaBookId, pages: List<Int>): Map<Int, ImageDimensions> {
+        if (diskCache == null) return emptyMap()
+        val snapshots = pages.mapNotNull { page ->
+            diskCache.openSnapshot(ReaderImage.PageId(bookId.value, page).toString())?.let { page to it }
+        }
+        if (snapshots.isEmpty()) return emptyMap()
+
+        return try {
+            val dimensions = imageDecoder.getDimensionsFromFiles(snapshots.map { (_, snapshot) -> snapshot.data.toString() })
+            snapshots.zip(dimensions)
+                .mapNotNull { (entry, pageDimensions) -> pageDimensions?.let { entry.first to it } }
+                .toMap()
+        } catch (e: Throwable) {
+            currentCoroutineContext().ensureActive()
+            logger.catching(e)
+            emptyMap()
+        } finally {
+            snapshots.forEach { (_, snapshot) -> snapshot.close() }
+        }
+    }
+
+    /**
+     * Cached pages are read from disk cache. Otherwise page is passed to decoder while it's being downloaded
+     * and is written to disk cache at the same time. Later decodes of the same image use [doLoad]
+     */
+    private suspend fun streamLoad(bookId: KomgaBookId, page: Int): ImageSource {
+        val pageId = ReaderImage.PageId(bookId.value, page)
+        diskCache?.openSnapshot(pageId.toString())?.let { return ImageSource.FilePathSource(it) }
+
+        val bookApi = bookClient.value
+        val opened = CompletableDeferred<PageStream>()
+        val download = downloadScope.launch {
+            try {
+                bookApi.streamPage(bookId, page) { channel ->
+                    val stream = PageStream(
+                        upstream = channel.toBlockingSource(),
+                        cacheEditor = diskCache?.openEditor(pageId.toString()),
+                        fileSystem = diskCache?.fileSystem
+                    )
+                    // download is cancelled only if the stream was never handed over to the caller
+                    try {
+                        opened.complete(stream)
+                        stream.awaitClose()
+                    } finally {
+                        stream.close()
+                    }
+                }
+            } catch (e: Throwable) {
+                opened.completeExceptionally(e)
+            }
+        }
+
+        val stream = try {
+            opened.await()
+        } catch (e: CancellationException) {
+            download.cancel()
+            throw e
+        }
+        return ImageSource.StreamSource(stream) { doLoad(bookId, page) }
+    }
+
     private suspend fun doLoad(bookId: KomgaBookId, page: Int): ImageSource {
         val pageId = ReaderImage.PageId(bookId.value, page)
         if (diskCache == null) {
@@ -126,4 +202,35 @@ sealed interface ImageSource : AutoCloseable {
             cacheLock?.close()
         }
     }
+
+    /**
+     * Page that is still being downloaded. Stream can be decoded only once,
+     * [fallback] loads the whole page for any later decode
+     */
+    class StreamSource(
+        stream: RawSource,
+        private val fallback: suspend () -> ImageSource,
+    ) : ImageSource {
+        private var stream: RawSource? = stream
+        private var fallbackSource: ImageSource? = null
+
+        val hasStream: Boolean
+            get() = stream != null
+
+        // ownership of returned stream is passed to the caller
+        fun takeStream(): RawSource? {
+            val taken = stream
+            stream = null
+            return taken
+        }
+
+        suspend fun getFallback(): ImageSource {
+            return fallbackSource ?: fallback().also { fallbackSource = it }
+        }
+
+        override fun close() {
+            takeStream()?.close()
+            fallbackSource?.close()
+        }
+    }
 }
\ No newline at end of file
@@ -11,6 +11,12 @@ interface KomeliaUpscaler {
 
     suspend fun upscale(image: KomeliaImage, cacheKey: String? = null): KomeliaImage?
 
+    /**
+     * Upscales only [region] of the image. Upscaled tiles are kept for recently used [cacheKey] pages
+     * and reused by following requests. Returns null if upscaling is disabled
+     */
+    suspend fun upscaleRegion(image: KomeliaImage, region: ImageRect, cacheKey: String): KomeliaImage?
+
     fun setOnnxModelPath(path: PlatformFile?)
     fun setUpscaleMode(mode: UpscaleMode)
     fun clearCache()
@@ -0,0 +1,96 @@
+package snd.komelia.image
+
+import coil3.disk.DiskCache
+import io.github.oshai.kotlinlogging.KotlinLogging
+import io.ktor.utils.io.ByteReadChannel
+import kotlinx.coroutines.CompletableDeferred
+import kotlinx.io.Buffer
+import kotlinx.io.RawSource
+import kotlinx.io.readByteArray
+import okio.BufferedSink
+import okio.FileSystem
+import okio.buffer
+import kotlin.concurrent.Volatile
+
+private val logger = KotlinLogging.logger {}
+
+// blocks reading thread until response bytes are available
+internal expect fun ByteReadChannel.toBlockingSource(): RawSource
+
+/**
+ * Page response body that is read by the decoder while it's still being downloaded.
+ * Received bytes are copied into disk cache entry, entry is committed once the whole body was read.
+ * Response is held open until the stream is closed
+ */
+internal class PageStream(
+    private val upstream: RawSource,
+    private val cacheEditor: DiskCache.Editor?,
+    fileSystem: FileSystem?,
+) : RawSource {
+    private var cacheSink: BufferedSink? = if (cacheEditor != null && fileSystem != null) {
+        fileSystem.sink(cacheEditor.data).buffer()
+    } else null
+
+    @Volatile
+    private var completed = false
+
+    @Volatile
+    private var closed = false
+    private val closeSignal = CompletableDeferred<Unit>()
+
+    override fun readAtMostTo(sink: Buffer, byteCount: Long): Long {
+        val buffer = Buffer()
+        val read = upstream.readAtMostTo(buffer, byteCount)
+        if (read == -1L) {
+            commitCacheEntry()
+            return -1
+        }
+
+        val bytes = buffer.readByteArray()
+        writeCacheEntry(bytes)
+        sink.write(bytes)
+        return read
+    }
+
+    override fun close() {
+        if (closed) return
+        closed = true
+        if (!completed) abortCacheEntry()
+        upstream.close()
+        closeSignal.complete(Unit)
+    }
+
+    suspend fun awaitClose() = closeSignal.await()
+
+    // failed cache write does not interrupt decoding, page is downloaded again on next load
+    private fun writeCacheEntry(bytes: ByteArray) {
+        val cache = cacheSink ?: return
+        try {
+            cache.write(bytes)
+        } catch (e: Exception) {
+            logger.catching(e)
+            abortCacheEntry()
+        }
+    }
+
+    private fun commitCacheEntry() {
+        if (completed) return
+        completed = true
+        val cache = cacheSink ?: return
+        cacheSink = null
+        try {
+            cache.close()
+            cacheEditor?.commit()
+        } catch (e: Exception) {
+            logger.catching(e)
+            cacheEditor?.abort()
+        }
+    }
+
+    private fun abortCacheEntry() {
+        val cache = cacheSink ?: return
+        cacheSink = null
+        runCatching { cache.close() }
+        cacheEditor?.abort()
+    }
+}
@@ -30,6 +30,8 @@ import kotlinx.coroutines.flow.update
 import kotlinx.coroutines.isActive
 import kotlinx.coroutines.launch
 import kotlinx.coroutines.selects.select
+import kotlinx.coroutines.sync.Mutex
+import kotlinx.coroutines.sync.withLock
 import snd.komelia.image.processing.ImageProcessingPipeline
 import kotlin.concurrent.Volatile
 import kotlin.math.round
@@ -75,6 +77,17 @@ abstract class TilingReaderImage(
     @Volatile
     private var originalImage: KomeliaImage? = null
 
+    // original image was decoded with shrink-on-load and has to be decoded again
+    // in full resolution when zoomed past its size or when original image is requested
+    @Volatile
+    private var isReducedImage = false
+
+    @Volatile
+    private var reducedImageScale = 1.0
+
+    // full resolution reload can be requested by zoom update and by original image request at the same time
+    private val reloadMutex = Mutex()
+
     @Volatile
     protected var lastUpdateRequest: UpdateRequest? = null
 
@@ -109,7 +122,7 @@ abstract class TilingReaderImage(
             }
 
             image.value = null
-            originalSize.value = originalImage?.let { IntSize(it.width, it.pageHeight) }
+            originalSize.value = originalImage?.let { toOriginalSize(it) }
             currentSize.value = null
             loadImage()
             reloadLastRequest()
@@ -180,6 +193,9 @@ abstract class TilingReaderImage(
     }
 
     override suspend fun getOriginalImage(): Result<KomeliaImage> {
+        if (isReducedImage) {
+            processingScope.launch { reloadFullResolution() }.join()
+        }
         return coroutineScope {
             select {
                 async { image.filterNotNull().first() }.onAwait { Result.success(it) }
@@ -188,13 +204,19 @@ abstract class TilingReaderImage(
         }
     }
 
-    private suspend fun loadImage() {
+    private suspend fun loadImage(targetSize: IntSize? = displaySizeHint) {
         try {
-            val originalImage = decodeImage(imageSource)
+            val displayImage = targetSize?.let { decodeImageForDisplay(imageSource, it) }
+            val originalImage = displayImage?.image ?: decodeImage(imageSource)
+            val previousImage = this.originalImage
             this.originalImage = originalImage
+            if (previousImage !== originalImage) previousImage?.close()
+            this.isReducedImage = displayImage?.isReduced ?: false
+            this.reducedImageScale = displayImage?.let { it.originalWidth.toDouble() / it.image.width } ?: 1.0
+
             val processed = processingPipeline.process(pageId, originalImage)
             image.value = processed
-            originalSize.value = IntSize(processed.width, processed.pageHeight)
+            originalSize.value = toOriginalSize(processed)
         } catch (e: Throwable) {
             currentCoroutineContext().ensureActive()
             logger.catching(e)
@@ -203,16 +225,22 @@ abstract class TilingReaderImage(
         }
     }
 
-    private suspend fun decodeImage(source: ImageSource): KomeliaImage {
+    protected open suspend fun decodeImage(source: ImageSource): KomeliaImage {
         val image = when (source) {
             is ImageSource.FilePathSource -> imageDecoder.decodeFromFile(source.path)
             is ImageSource.MemorySource -> imageDecoder.decode(source.data)
+            is ImageSource.StreamSource -> {
+                val stream = source.takeStream() ?: return decodeImage(source.getFallback())
+                imageDecoder.decodeFromStream(stream)
+            }
         }
         return if (image.pagesTotal != 1) {
             image.close()
             when (source) {
                 is ImageSource.FilePathSource -> imageDecoder.decodeFromFile(source.path, -1)
                 is ImageSource.MemorySource -> imageDecoder.decode(source.data, -1)
+                // stream was consumed by the first decode, all frames are decoded from fully loaded page
+                is ImageSource.StreamSource -> decodeImage(source.getFallback())
             }
         } else {
             image
@@ -220,6 +248,61 @@ abstract class TilingReaderImage(
 
     }
 
+    /**
+     * Decodes image at reduced resolution that covers [targetSize].
+     * Returns null if image should be decoded in full resolution instead
+     */
+    protected open suspend fun decodeImageForDisplay(source: ImageSource, targetSize: IntSize): DisplayImage? {
+        val displayImage = when (source) {
+            is ImageSource.FilePathSource ->
+                imageDecoder.decodeFromFileForDisplay(source.path, targetSize.width, targetSize.height)
+
+            is ImageSource.MemorySource ->
+                imageDecoder.decodeForDisplay(source.data, targetSize.width, targetSize.height)
+
+            // page is still being downloaded, decode it in full from the stream instead of waiting for the whole file
+            is ImageSource.StreamSource ->
+                if (source.hasStream) return null
+                else return decodeImageForDisplay(source.getFallback(), targetSize)
+        }
+
+        // animated images are always decoded in full
+        if (displayImage.image.pagesTotal != 1) {
+            displayImage.image.close()
+            return null
+        }
+        return displayImage
+    }
+
+    // size of the image in full resolution even if currently loaded image is reduced
+    private fun toOriginalSize(image: KomeliaImage): IntSize {
+        if (!isReducedImage) return IntSize(image.width, image.pageHeight)
+        return IntSize(
+            (image.width * reducedImageScale).roundToInt(),
+            (image.pageHeight * reducedImageScale).roundToInt()
+        )
+    }
+
+    private suspend fun reloadFullResolution() {
+        reloadMutex.withLock {
+            // already reloaded by another caller
+            if (!isReducedImage) return
+            // cleared before suspending so that following updates don't start another reload
+            isReducedImage = false
+
+            val currentImage = image.value
+            if (currentImage !== originalImage) {
+                currentImage?.close()
+            }
+            image.value = null
+            originalImage?.close()
+            originalImage = null
+            lastUsedScaleFactor = null
+
+            loadImage(targetSize = null)
+        }
+    }
+
     private suspend fun getCurrentImage(): KomeliaImage {
         return imageAwaitScope.async { image.filterNotNull().first() }.await()
     }
@@ -229,6 +312,7 @@ abstract class TilingReaderImage(
         zoomFactor: Float,
         visibleDisplaySize: IntRect,
     ) {
+        displaySizeHint = maxDisplaySize
         jobFlow.tryEmit(
             UpdateRequest(
                 visibleDisplaySize = visibleDisplaySize,
@@ -241,15 +325,21 @@ abstract class TilingReaderImage(
     private suspend fun doUpdate(request: UpdateRequest) {
         lastUpdateRequest = request
 
-        val image = getCurrentImage()
+        var image = getCurrentImage()
         val displaySize = calculateSizeForArea(request.maxDisplaySize, stretchImages.value) ?: return
-        val widthRatio = displaySize.width.toDouble() / image.width
-        val heightRatio = displaySize.height.toDouble() / image.pageHeight
-        val displayScaleFactor = widthRatio.coerceAtMost(heightRatio)
+        var displayScaleFactor = getDisplayScaleFactor(image, displaySize)
 
         val zoomFactor = request.zoomFactor
         val visibleDisplaySize = request.visibleDisplaySize
 
+        if (isReducedImage && displayScaleFactor * zoomFactor > 1.0) {
+            // zoomed in past reduced image resolution
+            reloadFullResolution()
+            // reloaded image never becomes available if decode failed
+            if (error.value != null) return
+            image = getCurrentImage()
+            displayScaleFactor = getDisplayScaleFactor(image, displaySize)
+        }
         val actualScaleFactor = displayScaleFactor * zoomFactor
 
         val dstWidth = displaySize.width * zoomFactor
@@ -283,6 +373,15 @@ abstract class TilingReaderImage(
                 tileSize = tileSize
             )
         }
+
+        val originalImage = this.originalImage
+        if (originalImage != null && !isReducedImage) onFullResolutionImageDisplayed(originalImage)
+    }
+
+    private fun getDisplayScaleFactor(image: KomeliaImage, displaySize: IntSize): Double {
+        val widthRatio = displaySize.width.toDouble() / image.width
+        val heightRatio = displaySize.height.toDouble() / image.pageHeight
+        return widthRatio.coerceAtMost(heightRatio)
     }
 
     private suspend fun doFullResize(
@@ -358,7 +457,8 @@ abstract class TilingReaderImage(
         val oldTiles = frameData.value?.frames?.first()?.tiles ?: emptyList()
         val newTiles = mutableListOf<ReaderImageTile>()
         val unusedTiles = mutableListOf<ReaderImageTile>()
-        var addedNewTiles = false
+        val pendingRegions = mutableListOf<IntRect>()
+        val pendingDisplayRegions = mutableListOf<Rect>()
 
         var yTaken = 0
         while (yTaken != image.height) {
@@ -394,30 +494,26 @@ abstract class TilingReaderImage(
                     }
                 }
 
-                val tileWidth = tileRegion.right - tileRegion.left
-                val tileHeight = tileRegion.bottom - tileRegion.top
-                val scaledTile = getImageRegion(
-                    image,
-                    tileRegion,
-                    ((tileWidth) * scaleFactor).roundToInt(),
-                    ((tileHeight) * scaleFactor).roundToInt()
-                )
-
-                val tile = ReaderImageTile(
-                    size = IntSize(scaledTile.width, scaledTile.height),
-                    displayRegion = tileDisplayRegion,
-                    isVisible = true,
-                    renderImage = scaledTile.frames.first()
-                )
-
-                newTiles.add(tile)
-                addedNewTiles = true
+                pendingRegions.add(tileRegion)
+                pendingDisplayRegions.add(tileDisplayRegion)
                 xTaken = (xTaken + tileSize).coerceAtMost(image.width)
             }
             yTaken = (yTaken + tileSize).coerceAtMost(image.height)
         }
 
-        if (addedNewTiles) {
+        if (pendingRegions.isNotEmpty()) {
+            val scaledTiles = getImageRegions(image, pendingRegions, scaleFactor)
+            scaledTiles.forEachIndexed { i, scaledTile ->
+                newTiles.add(
+                    ReaderImageTile(
+                        size = IntSize(scaledTile.width, scaledTile.height),
+                        displayRegion = pendingDisplayRegions[i],
+                        isVisible = true,
+                        renderImage = scaledTile.frames.first()
+                    )
+                )
+            }
+
             frameData.value = FrameData(
                 frames = listOf(ImageFrame(newTiles, 0)),
                 displaySize = displayArea,
@@ -464,6 +560,32 @@ abstract class TilingReaderImage(
         scaleHeight: Int
     ): ReaderImageData
 
+    // called on processing thread after full resolution image was rendered
+    protected open suspend fun onFullResolutionImageDisplayed(originalImage: KomeliaImage) {}
+
+    // implementations can override to process all tiles at once instead of one region at a time
+    protected open suspend fun getImageRegions(
+        image: KomeliaImage,
+        imageRegions: List<IntRect>,
+        scaleFactor: Double,
+    ): List<ReaderImageData> {
+        return imageRegions.map { region ->
+            getImageRegion(
+                image,
+                region,
+                (region.width * scaleFactor).roundToInt(),
+                (region.height * scaleFactor).roundToInt()
+            )
+        }
+    }
+
+    companion object {
+        // reader viewport size of the last update request.
+        // Pages share the same viewport, new pages use it to decode at display resolution
+        @Volatile
+        private var displaySizeHint: IntSize? = null
+    }
+
     data class ReaderImageTile(
         val size: IntSize,
         val displayRegion: Rect,
@@ -11,12 +11,16 @@ import coil3.request.Options
 import coil3.size.Scale
 import coil3.size.isOriginal
 import coil3.size.pxOrElse
+import io.github.oshai.kotlinlogging.KotlinLogging
 import kotlinx.coroutines.currentCoroutineContext
 import kotlinx.coroutines.ensureActive
 import okio.Path
 import okio.use
 import snd.komelia.image.KomeliaImage
 import snd.komelia.image.KomeliaImageDecoder
+import snd.komelia.image.KomeliaThumbnailStore
+
+private val logger = KotlinLogging.logger {}
 
 class CoilDecoder(
     private val source: ImageSource,
@@ -57,7 +61,10 @@ class CoilDecoder(
     }
 }
 
-class CoilAwareDecoder(private val imageDecoder: KomeliaImageDecoder) {
+class CoilAwareDecoder(
+    private val imageDecoder: KomeliaImageDecoder,
+    private val thumbnailStore: KomeliaThumbnailStore? = null,
+) {
 
     suspend fun decodeFromFile(path: Path, options: Options): KomeliaImage {
         if (options.size.isOriginal) {
@@ -87,6 +94,36 @@ class CoilAwareDecoder(private val imageDecoder: KomeliaImageDecoder) {
         )
     }
 
+    /**
+     * Returns previously stored thumbnail of the same size for [key]
+     * or null if there's none or request is not for a resized image
+     */
+    suspend fun getStored(key: String, options: Options): KomeliaImage? {
+        if (thumbnailStore == null || options.size.isOriginal) return null
+        return try {
+            thumbnailStore.get(storeKey(key, options))
+        } catch (e: Exception) {
+            currentCoroutineContext().ensureActive()
+            logger.catching(e)
+            null
+        }
+    }
+
+    suspend fun store(key: String, options: Options, image: KomeliaImage) {
+        if (thumbnailStore == null || options.size.isOriginal) return
+        try {
+            thumbnailStore.put(storeKey(key, options), image)
+        } catch (e: Exception) {
+            currentCoroutineContext().ensureActive()
+            logger.catching(e)
+        }
+    }
+
+    private fun storeKey(key: String, options: Options): String {
+        val dstSize = calculateDstSize(options)
+        return "$key/${dstSize.width}x${dstSize.height}/${options.scale.name}"
+    }
+
     private fun calculateDstSize(options: Options): IntSize {
         val dstWidth = options.size.width.pxOrElse { Int.MAX_VALUE }
         val dstHeight = options.size.height.pxOrElse { Int.MAX_VALUE }
@@ -23,10 +23,25 @@ abstract class CoilFetcher(
 
     protected abstract suspend fun fetchBytes(): ByteArray?
 
+    // key of persistently stored thumbnail. Only set for requests whose image doesn't change on the server
+    protected open val storeKey: String? = null
+
     // decode right away to avoid copying bytearray into okio buffer
     override suspend fun fetch(): FetchResult? {
+        val storeKey = storeKey
+        if (storeKey != null) {
+            decoder.getStored(storeKey, options)?.use { image ->
+                return ImageFetchResult(
+                    image = image.toCoilImage(),
+                    isSampled = !options.size.isOriginal,
+                    dataSource = DataSource.DISK
+                )
+            }
+        }
+
         val bytes = fetchBytes() ?: return null
         decoder.decodeBytes(bytes, options).use { image ->
+            if (storeKey != null) decoder.store(storeKey, options, image)
             return ImageFetchResult(
                 image = image.toCoilImage(),
                 isSampled = !options.size.isOriginal,
@@ -52,6 +67,7 @@ class KomgaBookThumbnailFetcher(
     decoder: CoilAwareDecoder,
     options: Options,
 ) : CoilFetcher(decoder, options) {
+    override val storeKey = "book/${bookId.value}/thumbnail/${thumbnailId.value}"
     override suspend fun fetchBytes() = bookApi.getThumbnail(bookId, thumbnailId)
 }
 
@@ -71,6 +87,7 @@ class KomgaSeriesThumbnailFetcher(
     decoder: CoilAwareDecoder,
     options: Options,
 ) : CoilFetcher(decoder, options) {
+    override val storeKey = "series/${seriesId.value}/thumbnail/${thumbnailId.value}"
     override suspend fun fetchBytes() = seriesApi.getThumbnail(seriesId, thumbnailId)
 }
 
@@ -90,6 +107,7 @@ class KomgaCollectionThumbnailFetcher(
     decoder: CoilAwareDecoder,
     options: Options,
 ) : CoilFetcher(decoder, options) {
+    override val storeKey = "collection/${collectionId.value}/thumbnail/${thumbnailId.value}"
     override suspend fun fetchBytes() = collectionApi.getThumbnail(collectionId, thumbnailId)
 }
 
@@ -109,6 +127,7 @@ class KomgaReadListThumbnailFetcher(
     decoder: CoilAwareDecoder,
     options: Options,
 ) : CoilFetcher(decoder, options) {
+    override val storeKey = "readlist/${readListId.value}/thumbnail/${thumbnailId.value}"
     override suspend fun fetchBytes() = readListApi.getThumbnail(readListId, thumbnailId)
 }
 
@@ -119,5 +138,6 @@ class KomgaBookPageThumbnailFetcher(
     decoder: CoilAwareDecoder,
     options: Options,
 ) : CoilFetcher(decoder, options) {
+    override val storeKey = "book/${bookId.value}/page/$pageNumber"
     override suspend fun fetchBytes() = bookApi.getPageThumbnail(bookId, pageNumber)
 }
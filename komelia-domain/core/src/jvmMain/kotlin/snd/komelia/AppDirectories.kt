@@ -47,6 +47,7 @@ object AppDirectories {
     val coilCachePath: Path = cachePath.resolve("coil")
     val readerCachePath: Path = cachePath.resolve("reader")
     val readerUpscaleCachePath: Path = cachePath.resolve("reader_upscale")
+    val thumbnailStorePath: Path = cachePath.resolve("thumbnails")
 
     val databaseDirectory: Path = Path(projectDirectories.dataDir)
 }
\ No newline at end of file
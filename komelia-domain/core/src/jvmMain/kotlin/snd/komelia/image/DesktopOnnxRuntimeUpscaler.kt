@@ -19,11 +19,13 @@ import kotlinx.coroutines.sync.Mutex
 import kotlinx.coroutines.sync.withLock
 import kotlinx.coroutines.withContext
 import okio.Path.Companion.toOkioPath
+import okio.Path.Companion.toPath
 import org.apache.commons.io.FileUtils
 import snd.komelia.AppDirectories
 import snd.komelia.AppDirectories.mangaJaNaiInstallPath
 import snd.komelia.AppDirectories.mangaJaNaiOldInstallPath
 import snd.komelia.onnxruntime.OnnxRuntimeExecutionProvider
+import snd.komelia.onnxruntime.OnnxRuntimeTileCache
 import snd.komelia.onnxruntime.OnnxRuntimeUpscaler
 import snd.komelia.settings.ImageReaderSettingsRepository
 import snd.komelia.updates.OnnxModelDownloader.CompletionEvent.MangaJaNaiDownloaded
@@ -36,6 +38,20 @@ import kotlin.time.TimeSource
 
 private val logger = KotlinLogging.logger {}
 
+// max page height to model name
+private val mangaJaNaiGrayscaleModels = listOf(
+    1250 to "2x_MangaJaNai_1200p_V1_ESRGAN_70k.onnx",
+    1350 to "2x_MangaJaNai_1300p_V1_ESRGAN_75k.onnx",
+    1450 to "2x_MangaJaNai_1400p_V1_ESRGAN_70k.onnx",
+    1550 to "2x_MangaJaNai_1500p_V1_ESRGAN_90k.onnx",
+    1760 to "2x_MangaJaNai_1600p_V1_ESRGAN_90k.onnx",
+    1984 to "2x_MangaJaNai_1920p_V1_ESRGAN_70k.onnx",
+    Int.MAX_VALUE to "2x_MangaJaNai_2048p_V1_ESRGAN_95k.onnx",
+)
+
+// pages with region upscale tiles kept in memory. Each page only keeps tiles around its last upscaled region
+private const val maxTileCachePages = 3
+
 class DesktopOnnxRuntimeUpscaler(
     private val settingsRepository: ImageReaderSettingsRepository,
     private val executionProvider: OnnxRuntimeExecutionProvider,
@@ -55,9 +71,19 @@ class DesktopOnnxRuntimeUpscaler(
 
     private val imageCache = DiskCache.Builder()
         .directory(AppDirectories.readerUpscaleCachePath.createDirectories().toOkioPath())
-        .maxSizeBytes(500L * 1024 * 1024) // 500mb
+        // pages are stored uncompressed
+        .maxSizeBytes(2048L * 1024 * 1024) // 2gb
         .build()
 
+    // upscaled tiles of recently zoomed pages in least recently used order
+    private val tileCaches = object : LinkedHashMap<String, OnnxRuntimeTileCache>(maxTileCachePages + 1, 0.75f, true) {
+        override fun removeEldestEntry(eldest: MutableMap.MutableEntry<String, OnnxRuntimeTileCache>): Boolean {
+            if (size <= maxTileCachePages) return false
+            eldest.value.close()
+            return true
+        }
+    }
+
     suspend fun initialize() {
         //TODO remove after several releases
         if (mangaJaNaiOldInstallPath.exists()) {
@@ -90,37 +116,63 @@ class DesktopOnnxRuntimeUpscaler(
             val start = timeSource.markNow()
             val result = withContext(Dispatchers.IO) {
                 if (cacheKey == null) {
-                    when (upscaleMode.value) {
-                        UpscaleMode.NONE -> null
-                        UpscaleMode.USER_SPECIFIED_MODEL -> userModelUpscale(image)
-                        UpscaleMode.MANGAJANAI_PRESET -> mangaJaNaiUpscale(image, cacheKey)
-                    }
+                    upscaleWithCurrentMode(image, cacheKey) { ortUpscaler.upscale(it) }
                 } else imageCache.openSnapshot(cacheKey).use { snapshot ->
                     if (snapshot != null) {
-                        return@withContext VipsBackedImage(VipsImage.decodeFromFile(snapshot.data.toString()))
-                    }
-
-                    val upscaled = when (upscaleMode.value) {
-                        UpscaleMode.USER_SPECIFIED_MODEL -> ortUpscaler.upscale(image)
-                        UpscaleMode.MANGAJANAI_PRESET -> mangaJaNaiUpscale(image, cacheKey)
-                        UpscaleMode.NONE -> null
-                    }
-
-                    upscaled?.let { newImage ->
-                        if (image.pagesLoaded == 1) writeToDiskCache(newImage, cacheKey)
+                        return@withContext VipsBackedImage(decodeFromDiskCache(snapshot.data.toString()))
                     }
 
-                    return@withContext upscaled
+                    if (image.pagesLoaded == 1) upscaleToDiskCache(image, cacheKey)
+                    else upscaleWithCurrentMode(image, cacheKey) { ortUpscaler.upscale(it) }
                 }
             }
             if (result != null) {
                 val end = timeSource.markNow()
                 logger.info { "image $cacheKey completed ORT upscaling in ${end - start}" }
+                logger.debug { "native stage stats:\n${NativeStageStats.snapshot().joinToString("\n")}" }
             }
             return result
         }
     }
 
+    override suspend fun upscaleRegion(image: KomeliaImage, region: ImageRect, cacheKey: String): KomeliaImage? {
+        mutex.withLock {
+            return withContext(Dispatchers.IO) {
+                // full page upscaled earlier is cheaper to reuse than upscaling tiles
+                imageCache.openSnapshot(cacheKey)?.use { snapshot ->
+                    VipsBackedImage(decodeFromDiskCache(snapshot.data.toString())).use { page ->
+                        // assume upscaling is done by integer fraction (2x, 4x etc.)
+                        val scale = page.width / image.width
+                        return@withContext page.extractArea(
+                            ImageRect(
+                                left = region.left * scale,
+                                top = region.top * scale,
+                                right = region.right * scale,
+                                bottom = region.bottom * scale
+                            )
+                        )
+                    }
+                }
+
+                val modelIsSet = when (upscaleMode.value) {
+                    UpscaleMode.NONE -> false
+                    UpscaleMode.USER_SPECIFIED_MODEL -> setUserModel()
+                    UpscaleMode.MANGAJANAI_PRESET -> {
+                        setMangaJaNaiModel(image, cacheKey)
+                        true
+                    }
+                }
+                if (!modelIsSet) return@withContext null
+
+                // caches are only closed under mutex, inference doesn't need to hold the map lock
+                val tileCache = synchronized(tileCaches) {
+                    tileCaches.getOrPut(cacheKey) { ortUpscaler.createTileCache() }
+                }
+                ortUpscaler.upscaleRegion(image, region, tileCache)
+            }
+        }
+    }
+
     override fun setOnnxModelPath(path: PlatformFile?) {
         if (path == null) {
             scope.launch { settingsRepository.putUpscalerOnnxModel(path) }
@@ -141,48 +193,83 @@ class DesktopOnnxRuntimeUpscaler(
 
     override fun clearCache() {
         imageCache.clear()
+        val caches = synchronized(tileCaches) {
+            tileCaches.values.toList().also { tileCaches.clear() }
+        }
+        // cache can still be in use by region upscale, close it once current upscale is finished
+        if (caches.isNotEmpty()) {
+            scope.launch { mutex.withLock { caches.forEach { it.close() } } }
+        }
     }
 
     override fun closeCurrentSession() {
         ortUpscaler.closeCurrentSession()
     }
 
-    private fun writeToDiskCache(image: KomeliaImage, cacheKey: String) {
-        val vipsImage = image.toVipsImage()
-        val editor = imageCache.openEditor(cacheKey) ?: return
+    // entries left by previous versions are stored as png
+    private fun decodeFromDiskCache(path: String): VipsImage {
+        return try {
+            VipsImage.decodeFromFileVips(path)
+        } catch (e: VipsException) {
+            VipsImage.decodeFromFile(path)
+        }
+    }
+
+    // upscaled page is written straight into the cache entry and lazily decoded from it
+    private suspend fun upscaleToDiskCache(image: KomeliaImage, cacheKey: String): KomeliaImage? {
+        val editor = imageCache.openEditor(cacheKey)
+            ?: return upscaleWithCurrentMode(image, cacheKey) { ortUpscaler.upscale(it) }
+
+        // native writer selects vips format by file suffix
+        val vipsFile = "${editor.data}.v".toPath()
         try {
-            vipsImage.encodeToFilePng(editor.data.toString())
-            editor.commit()
+            val written = upscaleWithCurrentMode(image, cacheKey) { ortUpscaler.upscaleToFile(it, vipsFile.toString()) }
+            if (written == null) {
+                editor.abort()
+                return null
+            }
+            imageCache.fileSystem.atomicMove(vipsFile, editor.data)
         } catch (e: Exception) {
+            imageCache.fileSystem.delete(vipsFile)
             editor.abort()
             throw e
         }
+
+        return editor.commitAndOpenSnapshot()?.use { snapshot ->
+            VipsBackedImage(decodeFromDiskCache(snapshot.data.toString()))
+        }
     }
 
-    private fun userModelUpscale(image: KomeliaImage): KomeliaImage? {
-        val modelPath = userModelPath.value ?: return null
+    private fun setUserModel(): Boolean {
+        val modelPath = userModelPath.value ?: return false
         ortUpscaler.setModelPath(modelPath.path)
-        return ortUpscaler.upscale(image)
+        return true
     }
 
-    private suspend fun mangaJaNaiUpscale(image: KomeliaImage, cacheKey: String?): KomeliaImage {
+    // returns null if upscaling is disabled or model is not set
+    private suspend fun <T> upscaleWithCurrentMode(
+        image: KomeliaImage,
+        cacheKey: String?,
+        upscale: (KomeliaImage) -> T
+    ): T? {
+        return when (upscaleMode.value) {
+            UpscaleMode.NONE -> null
+            UpscaleMode.USER_SPECIFIED_MODEL -> if (setUserModel()) upscale(image) else null
+            UpscaleMode.MANGAJANAI_PRESET -> mangaJaNaiUpscale(image, cacheKey, upscale)
+        }
+    }
+
+    // returns index of selected grayscale model or null if illustration model is used
+    private suspend fun setMangaJaNaiModel(image: KomeliaImage, cacheKey: String?): Int? {
         if (!mangaJaNaiIsAvailable.value) {
             throw IllegalStateException("Upscale error: MangaJaNai models are not available")
         }
         val isGrayscale = if (image.type == ImageFormat.GRAYSCALE_8) true else isRgbaIsGrayscale(image)
 
+        val grayscaleModelIndex = if (isGrayscale) grayscaleModelIndex(image.height) else null
         val modelPath =
-            if (isGrayscale) {
-                val model = when (image.height) {
-                    in 0..1250 -> "2x_MangaJaNai_1200p_V1_ESRGAN_70k.onnx"
-                    in 1251..1350 -> "2x_MangaJaNai_1300p_V1_ESRGAN_75k.onnx"
-                    in 1351..1450 -> "2x_MangaJaNai_1400p_V1_ESRGAN_70k.onnx"
-                    in 1451..1550 -> "2x_MangaJaNai_1500p_V1_ESRGAN_90k.onnx"
-                    in 1551..1760 -> "2x_MangaJaNai_1600p_V1_ESRGAN_90k.onnx"
-                    in 1761..1984 -> "2x_MangaJaNai_1920p_V1_ESRGAN_70k.onnx"
-                    else -> "2x_MangaJaNai_2048p_V1_ESRGAN_95k.onnx"
-                }
-                mangaJaNaiInstallPath.resolve(model)
+            if (grayscaleModelIndex != null) {
+                mangaJaNaiInstallPath.resolve(mangaJaNaiGrayscaleModels[grayscaleModelIndex].second)
             } else {
                 val illustration2x = mangaJaNaiInstallPath.resolve("2x_IllustrationJaNai_V1_ESRGAN_120k.onnx")
                 val illustration4x = mangaJaNaiInstallPath.resolve("4x_IllustrationJaNai_V1_ESRGAN_135k.onnx")
@@ -193,10 +280,32 @@ class DesktopOnnxRuntimeUpscaler(
         logger.info { "image $cacheKey: using model ${modelPath.name}" }
 
         ortUpscaler.setModelPath(modelPath.toString())
-        val upscaled = ortUpscaler.upscale(image)
+        return grayscaleModelIndex
+    }
+
+    private suspend fun <T> mangaJaNaiUpscale(
+        image: KomeliaImage,
+        cacheKey: String?,
+        upscale: (KomeliaImage) -> T
+    ): T {
+        val grayscaleModelIndex = setMangaJaNaiModel(image, cacheKey)
+        val upscaled = upscale(image)
+
+        // pages of the same book usually have similar height.
+        // Prepare sessions for neighbouring models while current page is being read
+        if (grayscaleModelIndex != null) {
+            listOf(grayscaleModelIndex - 1, grayscaleModelIndex + 1)
+                .mapNotNull { mangaJaNaiGrayscaleModels.getOrNull(it) }
+                .forEach { (_, model) -> ortUpscaler.warmUp(mangaJaNaiInstallPath.resolve(model).toString()) }
+        }
         return upscaled
     }
 
+    private fun grayscaleModelIndex(height: Int): Int {
+        val index = mangaJaNaiGrayscaleModels.indexOfFirst { (maxHeight, _) -> height <= maxHeight }
+        return if (index == -1) mangaJaNaiGrayscaleModels.lastIndex else index
+    }
+
     private suspend fun isRgbaIsGrayscale(image: KomeliaImage): Boolean {
         val shrinkFactor = minOf(image.width, image.height) / 64.0
         val resized = image.shrink(ceil(shrinkFactor))
@@ -10,10 +10,12 @@ import androidx.compose.ui.graphics.toSkiaRect
 import androidx.compose.ui.unit.IntRect
 import androidx.compose.ui.unit.IntSize
 import androidx.compose.ui.unit.toSize
+import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.flow.StateFlow
 import kotlinx.coroutines.flow.drop
 import kotlinx.coroutines.flow.launchIn
 import kotlinx.coroutines.flow.onEach
+import kotlinx.coroutines.withContext
 import org.jetbrains.skia.Image
 import org.jetbrains.skia.Rect
 import org.jetbrains.skia.SamplingMode
@@ -55,6 +57,37 @@ class DesktopReaderImage(
         }?.launchIn(processingScope)
     }
 
+    @Volatile
+    private var isCached = false
+
+    // decoded pages are shared between reader image instances through native cache
+    // to avoid full decode when returning to recently viewed page
+    override suspend fun decodeImage(source: ImageSource): KomeliaImage {
+        val cached = withContext(Dispatchers.Default) { VipsImageCache.get(pageId.toString()) }
+        if (cached != null) {
+            isCached = true
+            return VipsBackedImage(cached)
+        }
+        return super.decodeImage(source)
+    }
+
+    // pages are cached only after they were displayed. Cache copy decodes the whole image,
+    // prefetched pages that are never shown or pages shown with shrink-on-load are not cached
+    override suspend fun onFullResolutionImageDisplayed(originalImage: KomeliaImage) {
+        if (isCached || originalImage !is VipsBackedImage) return
+        isCached = true
+        withContext(Dispatchers.Default) { VipsImageCache.put(pageId.toString(), originalImage.vipsImage) }
+    }
+
+    // prefer cached full resolution image. Reduced images are not cached
+    override suspend fun decodeImageForDisplay(source: ImageSource, targetSize: IntSize): DisplayImage? {
+        val cached = withContext(Dispatchers.Default) { VipsImageCache.get(pageId.toString()) }
+        if (cached != null) {
+            return DisplayImage(VipsBackedImage(cached), cached.width, cached.pageHeight)
+        }
+        return super.decodeImageForDisplay(source, targetSize)
+    }
+
     override fun closeTileBitmaps(tiles: List<ReaderImageTile>) {
         tiles.forEach { runCatching { it.renderImage?.close() } }
     }
@@ -119,6 +152,28 @@ class DesktopReaderImage(
         }
     }
 
+    override suspend fun getImageRegions(
+        image: KomeliaImage,
+        imageRegions: List<IntRect>,
+        scaleFactor: Double
+    ): List<ReaderImageData> {
+        if (scaleFactor > 1.0 || imageRegions.size < 2 || image !is VipsBackedImage) {
+            return super.getImageRegions(image, imageRegions, scaleFactor)
+        }
+
+        val tiles = image.extractAndResizeTiles(
+            tiles = imageRegions.map { it.toImageRect() },
+            scaleFactor = scaleFactor,
+            linear = linearLightDownSampling.value,
+            kernel = downSamplingKernel.value
+        )
+        try {
+            return tiles.map { it.toReaderImageData() }
+        } finally {
+            tiles.forEach { it.close() }
+        }
+    }
+
     private suspend fun upscaleImage(
         image: KomeliaImage,
         scaleWidth: Int,
@@ -154,22 +209,14 @@ class DesktopReaderImage(
         scaleWidth: Int,
         scaleHeight: Int
     ): ReaderImageData {
-        // try to reuse full resized image instead of upscaling individual regions
-        val upscaled = upscaler?.upscale(image, pageId.toString())
+        // only tiles covering the region are upscaled, tiles are reused while zoomed page is panned
+        val upscaled = upscaler?.upscaleRegion(image, imageRegion.toImageRect(), pageId.toString())
         var region: KomeliaImage? = null
         var resized: KomeliaImage? = null
 
         try {
             if (upscaled != null) {
-                // assume upscaling is done by integer fraction (2x, 4x etc.)
-                val scaleRatio = upscaled.width / image.width
-                val targetRegion = ImageRect(
-                    left = imageRegion.left * scaleRatio,
-                    right = imageRegion.right * scaleRatio,
-                    top = imageRegion.top * scaleRatio,
-                    bottom = imageRegion.bottom * scaleRatio
-                )
-                region = upscaled.extractArea(targetRegion)
+                region = upscaled
 
                 // downscale if region is bigger than requested scale
                 if (region.width > scaleWidth || region.pageHeight > scaleHeight) {
@@ -0,0 +1,8 @@
+package snd.komelia.image
+
+import io.ktor.utils.io.ByteReadChannel
+import io.ktor.utils.io.jvm.javaio.toInputStream
+import kotlinx.io.RawSource
+import kotlinx.io.asSource
+
+internal actual fun ByteReadChannel.toBlockingSource(): RawSource = toInputStream().asSource()
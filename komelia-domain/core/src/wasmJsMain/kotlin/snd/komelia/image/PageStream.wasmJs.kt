@@ -0,0 +1,8 @@
+package snd.komelia.image
+
+import io.ktor.utils.io.ByteReadChannel
+import kotlinx.io.RawSource
+
+// browser decoder does not support stream decode, pages are always downloaded in full
+internal actual fun ByteReadChannel.toBlockingSource(): RawSource =
+    throw UnsupportedOperationException("Blocking reads are not supported")
@@ -1,5 +1,6 @@
 package snd.komelia.komga.api
 
+import io.ktor.utils.io.ByteReadChannel
 import snd.komelia.komga.api.model.KomeliaBook
 import snd.komga.client.book.KomgaBookId
 import snd.komga.client.book.KomgaBookMetadataUpdateRequest
@@ -62,6 +63,14 @@ interface KomgaBookApi {
     suspend fun deleteBookThumbnail(bookId: KomgaBookId, thumbnailId: KomgaThumbnailId)
     suspend fun getAllReadListsByBook(bookId: KomgaBookId): List<KomgaReadList>
     suspend fun getPage(bookId: KomgaBookId, page: Int): ByteArray
+
+    /**
+     * Passes page bytes to [block] while they are received. Response is closed when [block] returns
+     */
+    suspend fun <T> streamPage(bookId: KomgaBookId, page: Int, block: suspend (ByteReadChannel) -> T): T {
+        return block(ByteReadChannel(getPage(bookId, page)))
+    }
+
     suspend fun getPageThumbnail(bookId: KomgaBookId, page: Int): ByteArray
 
     suspend fun getReadiumProgression(bookId: KomgaBookId): R2Progression?
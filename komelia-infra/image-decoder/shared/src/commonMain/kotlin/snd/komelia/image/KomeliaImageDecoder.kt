@@ -1,5 +1,9 @@
 package snd.komelia.image
 
+import kotlinx.io.RawSource
+import kotlinx.io.buffered
+import kotlinx.io.readByteArray
+
 interface KomeliaImageDecoder {
     suspend fun decode(encoded: ByteArray, nPages: Int? = null): KomeliaImage
     suspend fun decodeFromFile(path: String, nPages: Int? = null): KomeliaImage
@@ -18,4 +22,51 @@ interface KomeliaImageDecoder {
         crop: Boolean,
         nPages: Int? = null
     ): KomeliaImage
+
+    /**
+     * Decodes image at reduced resolution that still covers [targetWidth] x [targetHeight]
+     * if image format supports shrink-on-load. Falls back to full resolution decode otherwise
+     */
+    suspend fun decodeForDisplay(encoded: ByteArray, targetWidth: Int, targetHeight: Int): DisplayImage {
+        val image = decode(encoded)
+        return DisplayImage(image, image.width, image.pageHeight)
+    }
+
+    suspend fun decodeFromFileForDisplay(path: String, targetWidth: Int, targetHeight: Int): DisplayImage {
+        val image = decodeFromFile(path)
+        return DisplayImage(image, image.width, image.pageHeight)
+    }
+
+    /**
+     * Reads dimensions of [paths] from image headers without decoding pixels.
+     * Returns null for files that couldn't be read or if decoder doesn't support header only reads
+     */
+    suspend fun getDimensionsFromFiles(paths: List<String>): List<ImageDimensions?> {
+        return paths.map { null }
+    }
+
+    /**
+     * True if [decodeFromStream] decodes image while encoded bytes are still being read
+     * instead of reading the whole [RawSource] first
+     */
+    val supportsStreamDecode: Boolean
+        get() = false
+
+    /**
+     * Decodes image from encoded bytes read from blocking [source].
+     * [source] is closed when returned image and all images derived from it are released
+     */
+    suspend fun decodeFromStream(source: RawSource, nPages: Int? = null): KomeliaImage {
+        val encoded = source.buffered().use { it.readByteArray() }
+        return decode(encoded, nPages)
+    }
+}
+
+class DisplayImage(
+    val image: KomeliaImage,
+    val originalWidth: Int,
+    val originalHeight: Int,
+) {
+    val isReduced: Boolean
+        get() = image.width < originalWidth || image.pageHeight < originalHeight
 }
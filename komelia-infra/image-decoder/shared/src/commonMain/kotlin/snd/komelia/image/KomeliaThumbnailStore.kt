@@ -0,0 +1,9 @@
+package snd.komelia.image
+
+/**
+ * Persistent store of resized thumbnails that are returned without fetching and decoding the source image again
+ */
+interface KomeliaThumbnailStore {
+    suspend fun get(key: String): KomeliaImage?
+    suspend fun put(key: String, image: KomeliaImage)
+}
@@ -1,3 +1,4 @@
+#include "../vips/komelia_stage_stats.h"
 #include "../vips/vips_common_jni.h"
 #include <android/bitmap.h>
 #include <android/hardware_buffer_jni.h>
@@ -13,7 +14,10 @@ int convert_to_rgba(
     VipsInterpretation interpretation = vips_image_get_interpretation(input);
     if (interpretation != VIPS_INTERPRETATION_sRGB) {
         VipsImage *srgb = nullptr;
-        if (vips_colourspace(input, &srgb, VIPS_INTERPRETATION_sRGB, nullptr)) {
+        int64_t colourspace_start = komelia_stage_start();
+        int colourspace_error = vips_colourspace(input, &srgb, VIPS_INTERPRETATION_sRGB, nullptr);
+        komelia_stage_end(KOMELIA_STAGE_VIPS_COLOURSPACE, colourspace_start);
+        if (colourspace_error) {
             komelia_throw_jvm_vips_exception(env);
             g_object_unref(transformed);
             return -1;
@@ -39,6 +43,20 @@ int convert_to_rgba(
     return 0;
 }
 
+// android bitmaps expect premultiplied alpha. Opaque images are copied as is
+static void copy_rgba_row(
+    unsigned char *dst,
+    const unsigned char *src,
+    int width,
+    bool premultiply
+) {
+    if (premultiply) {
+        komelia_premultiply_rgba(dst, src, width);
+    } else {
+        memcpy(dst, src, width * 4);
+    }
+}
+
 JNIEXPORT jobject JNICALL Java_snd_komelia_image_AndroidBitmap_createHardwareBuffer(
     JNIEnv *env,
     jobject this,
@@ -48,6 +66,7 @@ JNIEXPORT jobject JNICALL Java_snd_komelia_image_AndroidBitmap_createHardwareBuf
     if (image == nullptr)
         return nullptr;
 
+    bool premultiply = !komelia_image_is_opaque(image);
     VipsImage *processed_input = nullptr;
     int conversion_error = convert_to_rgba(env, image, &processed_input);
     if (conversion_error) {
@@ -56,7 +75,9 @@ JNIEXPORT jobject JNICALL Java_snd_komelia_image_AndroidBitmap_createHardwareBuf
     int image_width = vips_image_get_width(processed_input);
     int image_height = vips_image_get_height(processed_input);
 
+    int64_t render_start = komelia_stage_start();
     unsigned char *image_data = (unsigned char *)vips_image_get_data(processed_input);
+    komelia_stage_end(KOMELIA_STAGE_VIPS_RENDER, render_start);
     if (image_data == nullptr) {
         komelia_throw_jvm_vips_exception(env);
         g_object_unref(processed_input);
@@ -104,17 +125,20 @@ JNIEXPORT jobject JNICALL Java_snd_komelia_image_AndroidBitmap_createHardwareBuf
         return nullptr;
     }
 
+    int64_t copy_start = komelia_stage_start();
     if (created_desc.stride == image_width) {
-        memcpy(write_buffer, image_data, image_width * image_height * 4);
+        copy_rgba_row(write_buffer, image_data, image_width * image_height, premultiply);
     } else {
         for (int y = 0; y < image_height; ++y) {
-            memcpy(
+            copy_rgba_row(
                 write_buffer + (created_desc.stride * y * 4),
                 image_data + (image_width * y * 4),
-                image_width * 4
+                image_width,
+                premultiply
             );
         }
     }
+    komelia_stage_end(KOMELIA_STAGE_VIPS_BITMAP_COPY, copy_start);
     int unlock_error = AHardwareBuffer_unlock(hardware_buffer, nullptr);
     g_object_unref(processed_input);
 
@@ -135,6 +159,10 @@ JNIEXPORT jobject JNICALL Java_snd_komelia_image_AndroidBitmap_createSoftwareBit
     jobject jvm_image
 ) {
     VipsImage *image = komelia_from_jvm_handle(env, jvm_image);
+    if (image == nullptr)
+        return nullptr;
+
+    bool premultiply = !komelia_image_is_opaque(image);
     VipsImage *processed_image = nullptr;
     int conversion_error = convert_to_rgba(env, image, &processed_image);
     if (conversion_error) {
@@ -143,7 +171,9 @@ JNIEXPORT jobject JNICALL Java_snd_komelia_image_AndroidBitmap_createSoftwareBit
 
     int image_width = vips_image_get_width(processed_image);
     int image_height = vips_image_get_height(processed_image);
+    int64_t render_start = komelia_stage_start();
     unsigned char *image_data = (unsigned char *)vips_image_get_data(processed_image);
+    komelia_stage_end(KOMELIA_STAGE_VIPS_RENDER, render_start);
     if (image_data == nullptr) {
         komelia_throw_jvm_vips_exception(env);
         g_object_unref(processed_image);
@@ -185,8 +215,21 @@ JNIEXPORT jobject JNICALL Java_snd_komelia_image_AndroidBitmap_createSoftwareBit
         g_object_unref(processed_image);
         return nullptr;
     }
-    memcpy(bitmap_data, image_data, info.height * info.stride);
+    int64_t copy_start = komelia_stage_start();
+    if (info.stride == info.width * 4) {
+        copy_rgba_row(bitmap_data, image_data, info.width * info.height, premultiply);
+    } else {
+        for (uint32_t y = 0; y < info.height; ++y) {
+            copy_rgba_row(
+                bitmap_data + info.stride * y,
+                image_data + info.width * y * 4,
+                info.width,
+                premultiply
+            );
+        }
+    }
 
+    komelia_stage_end(KOMELIA_STAGE_VIPS_BITMAP_COPY, copy_start);
     int unlock_error = AndroidBitmap_unlockPixels(env, jvm_bitmap);
     if (unlock_error) {
         komelia_throw_jvm_vips_exception_message(env, "Failed to unlock Bitmap");
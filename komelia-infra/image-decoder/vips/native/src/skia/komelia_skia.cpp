@@ -1,12 +1,14 @@
 #include <include/core/SkBitmap.h>
 #include <include/core/SkImage.h>
 #include <include/core/SkColorSpace.h>
+#include "../vips/komelia_stage_stats.h"
 #include "../vips/vips_common_jni.h"
 
 static sk_sp<SkColorSpace> srgbColorspace = SkColorSpace::MakeSRGB();
 
-void freeData(void *data, void *) {
-    free(data);
+// releases vips image that owns bitmap pixels
+void unrefVipsImage(void *, void *context) {
+    g_object_unref(static_cast<VipsImage *>(context));
 }
 
 extern "C" JNIEXPORT jobject JNICALL Java_snd_komelia_image_SkiaBitmap_directCopyToSkiaBitmap(
@@ -21,41 +23,70 @@ extern "C" JNIEXPORT jobject JNICALL Java_snd_komelia_image_SkiaBitmap_directCop
     int height = vips_image_get_height(image);
     int bands = vips_image_get_bands(image);
     size_t rowBytes = width * bands;
-    size_t size = height * rowBytes;
-    void *imageData = (void *) vips_image_get_data(image);
-    if (imageData == nullptr) {
+
+    // renders image once into vips owned memory or just takes a reference if image is already in memory.
+    // bitmap adopts that memory and releases it when pixels are no longer used
+    int64_t renderStart = komelia_stage_start();
+    VipsImage *memoryImage = vips_image_copy_memory(image);
+    komelia_stage_end(KOMELIA_STAGE_VIPS_RENDER, renderStart);
+    if (memoryImage == nullptr) {
         komelia_throw_jvm_vips_exception(env);
+        vips_thread_shutdown();
         return nullptr;
     }
+    vips_thread_shutdown();
 
-    void *dataCopy = malloc(height * rowBytes);
-    memcpy(dataCopy, imageData, size);
+    void *imageData = (void *) vips_image_get_data(memoryImage);
+    if (imageData == nullptr) {
+        komelia_throw_jvm_vips_exception(env);
+        g_object_unref(memoryImage);
+        return nullptr;
+    }
 
     auto *bitmap = new SkBitmap();
+    bool opaque = komelia_image_is_opaque(image);
     SkColorType colorType;
-    if (bands == 1) colorType = kGray_8_SkColorType;
-    else colorType = kRGBA_8888_SkColorType;
+    SkAlphaType alphaType;
+    if (bands == 1) {
+        colorType = kGray_8_SkColorType;
+        alphaType = kOpaque_SkAlphaType;
+    } else if (opaque) {
+        // alpha channel is padding, skia can skip blending
+        colorType = kRGB_888x_SkColorType;
+        alphaType = kOpaque_SkAlphaType;
+    } else {
+        colorType = kRGBA_8888_SkColorType;
+        alphaType = kPremul_SkAlphaType;
+    }
 
     SkImageInfo imageInfo = SkImageInfo::Make(width,
                                               height,
                                               colorType,
-                                              kUnpremul_SkAlphaType,
+                                              alphaType,
                                               srgbColorspace);
 
-    bool success = bitmap->tryAllocPixels(imageInfo, rowBytes);
-    if (!success) {
-        komelia_throw_jvm_vips_exception_message(env, "failed to allocate bitmap pixels");
-        delete bitmap;
-        free(dataCopy);
-        return nullptr;
-    }
-
-    success = bitmap->installPixels(imageInfo, dataCopy, rowBytes, freeData, nullptr);
-    if (!success) {
-        komelia_throw_jvm_vips_exception_message(env, "failed to install bitmap pixels");
-        delete bitmap;
-        free(dataCopy);
-        return nullptr;
+    if (alphaType == kPremul_SkAlphaType) {
+        // memory image can be shared with other references (e.g. image cache), premultiply into bitmap owned copy
+        if (!bitmap->tryAllocPixels(imageInfo, rowBytes)) {
+            komelia_throw_jvm_vips_exception_message(env, "failed to allocate bitmap pixels");
+            g_object_unref(memoryImage);
+            delete bitmap;
+            return nullptr;
+        }
+        int64_t copyStart = komelia_stage_start();
+        komelia_premultiply_rgba(static_cast<VipsPel *>(bitmap->getPixels()),
+                                 static_cast<const VipsPel *>(imageData),
+                                 static_cast<size_t>(width) * height);
+        komelia_stage_end(KOMELIA_STAGE_VIPS_BITMAP_COPY, copyStart);
+        g_object_unref(memoryImage);
+    } else {
+        bool success = bitmap->installPixels(imageInfo, imageData, rowBytes, unrefVipsImage, memoryImage);
+        if (!success) {
+            // installPixels calls release proc on failure
+            komelia_throw_jvm_vips_exception_message(env, "failed to install bitmap pixels");
+            delete bitmap;
+            return nullptr;
+        }
     }
     bitmap->setImmutable();
 
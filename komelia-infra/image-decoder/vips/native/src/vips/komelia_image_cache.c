@@ -0,0 +1,227 @@
+#include "komelia_image_cache.h"
+#include "vips_common_jni.h"
+
+typedef struct {
+    char *key;
+    VipsImage *image;
+    size_t size;
+    GList *lru_link;
+} CacheEntry;
+
+static GMutex cache_mutex;
+static GHashTable *cache_entries = nullptr;
+static GQueue cache_lru = G_QUEUE_INIT;
+static size_t cache_size = 0;
+// fits several decoded 4k-6k scans. Single entry is limited to a quarter of the cache size
+// so that one very large page doesn't evict everything else
+static size_t cache_max_size = 1024 * 1024 * 1024;
+static uint64_t cache_hits = 0;
+static uint64_t cache_misses = 0;
+static uint64_t cache_evictions = 0;
+
+static GHashTable *get_entries() {
+    if (cache_entries == nullptr) {
+        cache_entries = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+    return cache_entries;
+}
+
+// must be called with cache_mutex locked
+static void release_entry(CacheEntry *entry) {
+    g_hash_table_remove(get_entries(), entry->key);
+    g_queue_unlink(&cache_lru, entry->lru_link);
+    g_list_free_1(entry->lru_link);
+    cache_size -= entry->size;
+
+    g_object_unref(entry->image);
+    g_free(entry->key);
+    free(entry);
+}
+
+// must be called with cache_mutex locked
+static void evict_to_size(size_t max_size) {
+    while (cache_size > max_size) {
+        GList *last = g_queue_peek_tail_link(&cache_lru);
+        if (last == nullptr)
+            break;
+        release_entry(last->data);
+        ++cache_evictions;
+    }
+}
+
+VipsImage *komelia_image_cache_get(const char *key) {
+    g_mutex_lock(&cache_mutex);
+    CacheEntry *entry = g_hash_table_lookup(get_entries(), key);
+    if (entry == nullptr) {
+        ++cache_misses;
+        g_mutex_unlock(&cache_mutex);
+        return nullptr;
+    }
+
+    // move to the front of lru queue
+    g_queue_unlink(&cache_lru, entry->lru_link);
+    g_queue_push_head_link(&cache_lru, entry->lru_link);
+    ++cache_hits;
+
+    VipsImage *image = g_object_ref(entry->image);
+    g_mutex_unlock(&cache_mutex);
+    return image;
+}
+
+int komelia_image_cache_put(
+    const char *key,
+    VipsImage *image
+) {
+    size_t size = VIPS_IMAGE_SIZEOF_IMAGE(image);
+    g_mutex_lock(&cache_mutex);
+    bool fits = size <= cache_max_size / 4 && g_hash_table_lookup(get_entries(), key) == nullptr;
+    g_mutex_unlock(&cache_mutex);
+    if (!fits)
+        return 0;
+
+    // decode outside the lock. Memory copy doesn't reference source buffers that are owned by jvm
+    VipsImage *decoded = vips_image_copy_memory(image);
+    if (decoded == nullptr)
+        return -1;
+
+    g_mutex_lock(&cache_mutex);
+    CacheEntry *existing = g_hash_table_lookup(get_entries(), key);
+    if (existing != nullptr) {
+        release_entry(existing);
+    }
+
+    CacheEntry *entry = malloc(sizeof(CacheEntry));
+    entry->key = g_strdup(key);
+    entry->image = decoded;
+    entry->size = size;
+    entry->lru_link = g_list_alloc();
+    entry->lru_link->data = entry;
+
+    g_hash_table_insert(get_entries(), entry->key, entry);
+    g_queue_push_head_link(&cache_lru, entry->lru_link);
+    cache_size += size;
+    evict_to_size(cache_max_size);
+
+    g_mutex_unlock(&cache_mutex);
+    return 0;
+}
+
+void komelia_image_cache_remove(const char *key) {
+    g_mutex_lock(&cache_mutex);
+    CacheEntry *entry = g_hash_table_lookup(get_entries(), key);
+    if (entry != nullptr) {
+        release_entry(entry);
+    }
+    g_mutex_unlock(&cache_mutex);
+}
+
+void komelia_image_cache_clear() {
+    g_mutex_lock(&cache_mutex);
+    evict_to_size(0);
+    g_mutex_unlock(&cache_mutex);
+}
+
+void komelia_image_cache_set_max_size(size_t max_size_bytes) {
+    g_mutex_lock(&cache_mutex);
+    cache_max_size = max_size_bytes;
+    evict_to_size(cache_max_size);
+    g_mutex_unlock(&cache_mutex);
+}
+
+KomeliaImageCacheStats komelia_image_cache_get_stats() {
+    g_mutex_lock(&cache_mutex);
+    KomeliaImageCacheStats stats;
+    stats.hits = cache_hits;
+    stats.misses = cache_misses;
+    stats.evictions = cache_evictions;
+    stats.entries = g_hash_table_size(get_entries());
+    stats.size_bytes = cache_size;
+    stats.max_size_bytes = cache_max_size;
+    g_mutex_unlock(&cache_mutex);
+    return stats;
+}
+
+JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImageCache_get(
+    JNIEnv *env,
+    jobject this,
+    jstring key
+) {
+    const char *key_chars = (*env)->GetStringUTFChars(env, key, nullptr);
+    VipsImage *cached = komelia_image_cache_get(key_chars);
+    (*env)->ReleaseStringUTFChars(env, key, key_chars);
+
+    if (cached == nullptr)
+        return nullptr;
+
+    jobject jvm_image = komelia_to_jvm_handle(env, cached, nullptr);
+    if (jvm_image == nullptr) {
+        g_object_unref(cached);
+    }
+    return jvm_image;
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_image_VipsImageCache_put(
+    JNIEnv *env,
+    jobject this,
+    jstring key,
+    jobject jvm_image
+) {
+    VipsImage *image = komelia_from_jvm_handle(env, jvm_image);
+    if (image == nullptr)
+        return;
+
+    const char *key_chars = (*env)->GetStringUTFChars(env, key, nullptr);
+    int result = komelia_image_cache_put(key_chars, image);
+    (*env)->ReleaseStringUTFChars(env, key, key_chars);
+
+    if (result != 0) {
+        komelia_throw_jvm_vips_exception(env);
+    }
+    vips_thread_shutdown();
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_image_VipsImageCache_remove(
+    JNIEnv *env,
+    jobject this,
+    jstring key
+) {
+    const char *key_chars = (*env)->GetStringUTFChars(env, key, nullptr);
+    komelia_image_cache_remove(key_chars);
+    (*env)->ReleaseStringUTFChars(env, key, key_chars);
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_image_VipsImageCache_clear(
+    JNIEnv *env,
+    jobject this
+) {
+    komelia_image_cache_clear();
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_image_VipsImageCache_setMaxSize(
+    JNIEnv *env,
+    jobject this,
+    jlong max_size_bytes
+) {
+    komelia_image_cache_set_max_size(max_size_bytes);
+}
+
+JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImageCache_getStats(
+    JNIEnv *env,
+    jobject this
+) {
+    KomeliaImageCacheStats stats = komelia_image_cache_get_stats();
+
+    jclass jvm_stats_class = (*env)->FindClass(env, "snd/komelia/image/VipsImageCache$Stats");
+    jmethodID constructor = (*env)->GetMethodID(env, jvm_stats_class, "<init>", "(JJJJJJ)V");
+    return (*env)->NewObject(
+        env,
+        jvm_stats_class,
+        constructor,
+        (int64_t)stats.hits,
+        (int64_t)stats.misses,
+        (int64_t)stats.evictions,
+        (int64_t)stats.entries,
+        (int64_t)stats.size_bytes,
+        (int64_t)stats.max_size_bytes
+    );
+}
@@ -0,0 +1,33 @@
+#ifndef KOMELIA_IMAGE_CACHE_H
+#define KOMELIA_IMAGE_CACHE_H
+
+#include <vips/vips.h>
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t entries;
+    uint64_t size_bytes;
+    uint64_t max_size_bytes;
+} KomeliaImageCacheStats;
+
+// returns new reference to cached image or nullptr if there's no entry for the key
+VipsImage *komelia_image_cache_get(const char *key);
+
+// copies image to memory and stores it in cache. Images larger than a quarter of max cache size are skipped.
+// Returns -1 on copy error
+int komelia_image_cache_put(
+    const char *key,
+    VipsImage *image
+);
+
+void komelia_image_cache_remove(const char *key);
+
+void komelia_image_cache_clear();
+
+void komelia_image_cache_set_max_size(size_t max_size_bytes);
+
+KomeliaImageCacheStats komelia_image_cache_get_stats();
+
+#endif // KOMELIA_IMAGE_CACHE_H
@@ -0,0 +1,195 @@
+#include "komelia_stage_stats.h"
+
+#include <glib.h>
+#include <stdatomic.h>
+#include <string.h>
+
+typedef struct {
+    atomic_uint_least64_t count;
+    atomic_uint_least64_t total_us;
+    atomic_uint_least64_t max_us;
+    atomic_uint_least64_t histogram[KOMELIA_STAGE_HISTOGRAM_BUCKETS];
+} StageCounters;
+
+// written only by the owning thread, read and reset by other threads
+typedef struct {
+    StageCounters stages[KOMELIA_STAGE_COUNT];
+} ThreadCounters;
+
+static void retire_thread_counters(gpointer data);
+
+static GPrivate thread_counters_key = G_PRIVATE_INIT(retire_thread_counters);
+static GMutex threads_lock;
+static GSList *thread_counters = nullptr;
+// totals of exited threads
+static KomeliaStageStats retired_stats[KOMELIA_STAGE_COUNT];
+
+static const char *stage_names[KOMELIA_STAGE_COUNT] = {
+    "vips_decode",
+    "vips_colourspace",
+    "vips_render",
+    "vips_bitmap_copy",
+    "upscale_preprocess",
+    "upscale_tile_fetch",
+    "upscale_tensor_build",
+    "upscale_run",
+    "upscale_postprocess",
+    "upscale_join",
+    "rf_detr_preprocess",
+    "rf_detr_run",
+    "rf_detr_postprocess",
+    "stream_read",
+};
+
+static void add_counters(
+    KomeliaStageStats *stats,
+    StageCounters *counters
+) {
+    stats->count += atomic_load_explicit(&counters->count, memory_order_relaxed);
+    stats->total_us += atomic_load_explicit(&counters->total_us, memory_order_relaxed);
+    stats->max_us = MAX(stats->max_us, atomic_load_explicit(&counters->max_us, memory_order_relaxed));
+    for (int i = 0; i < KOMELIA_STAGE_HISTOGRAM_BUCKETS; ++i) {
+        stats->histogram[i] += atomic_load_explicit(&counters->histogram[i], memory_order_relaxed);
+    }
+}
+
+static void retire_thread_counters(gpointer data) {
+    ThreadCounters *counters = data;
+    g_mutex_lock(&threads_lock);
+    for (int i = 0; i < KOMELIA_STAGE_COUNT; ++i) {
+        add_counters(&retired_stats[i], &counters->stages[i]);
+    }
+    thread_counters = g_slist_remove(thread_counters, counters);
+    g_mutex_unlock(&threads_lock);
+    g_free(counters);
+}
+
+static ThreadCounters *get_thread_counters() {
+    ThreadCounters *counters = g_private_get(&thread_counters_key);
+    if (counters != nullptr)
+        return counters;
+
+    counters = g_new0(ThreadCounters, 1);
+    g_private_set(&thread_counters_key, counters);
+    g_mutex_lock(&threads_lock);
+    thread_counters = g_slist_prepend(thread_counters, counters);
+    g_mutex_unlock(&threads_lock);
+    return counters;
+}
+
+static int histogram_bucket(uint64_t duration) {
+    int bucket = 0;
+    while (bucket < KOMELIA_STAGE_HISTOGRAM_BUCKETS - 1 && (duration >> (bucket + 1)) != 0) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+JNIEXPORT int64_t komelia_stage_start() {
+    return g_get_monotonic_time();
+}
+
+JNIEXPORT void komelia_stage_end(
+    KomeliaStage stage,
+    int64_t start
+) {
+    uint64_t duration = (uint64_t)(g_get_monotonic_time() - start);
+    // counters are not shared between threads, atomic operations are uncontended
+    StageCounters *counters = &get_thread_counters()->stages[stage];
+    atomic_fetch_add_explicit(&counters->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->total_us, duration, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters->histogram[histogram_bucket(duration)], 1, memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&counters->max_us, memory_order_relaxed);
+    while (duration > max &&
+           !atomic_compare_exchange_weak_explicit(
+               &counters->max_us,
+               &max,
+               duration,
+               memory_order_relaxed,
+               memory_order_relaxed
+           )) {
+    }
+}
+
+JNIEXPORT const char *komelia_stage_name(KomeliaStage stage) {
+    return stage_names[stage];
+}
+
+JNIEXPORT void komelia_stage_stats_snapshot(KomeliaStageStats *stats) {
+    g_mutex_lock(&threads_lock);
+    for (int i = 0; i < KOMELIA_STAGE_COUNT; ++i) {
+        stats[i] = retired_stats[i];
+    }
+    for (GSList *link = thread_counters; link != nullptr; link = link->next) {
+        ThreadCounters *counters = link->data;
+        for (int i = 0; i < KOMELIA_STAGE_COUNT; ++i) {
+            add_counters(&stats[i], &counters->stages[i]);
+        }
+    }
+    g_mutex_unlock(&threads_lock);
+}
+
+// durations recorded concurrently with reset may be partially kept
+JNIEXPORT void komelia_stage_stats_reset() {
+    g_mutex_lock(&threads_lock);
+    memset(retired_stats, 0, sizeof(retired_stats));
+    for (GSList *link = thread_counters; link != nullptr; link = link->next) {
+        ThreadCounters *counters = link->data;
+        for (int i = 0; i < KOMELIA_STAGE_COUNT; ++i) {
+            StageCounters *stage = &counters->stages[i];
+            atomic_store_explicit(&stage->count, 0, memory_order_relaxed);
+            atomic_store_explicit(&stage->total_us, 0, memory_order_relaxed);
+            atomic_store_explicit(&stage->max_us, 0, memory_order_relaxed);
+            for (int j = 0; j < KOMELIA_STAGE_HISTOGRAM_BUCKETS; ++j) {
+                atomic_store_explicit(&stage->histogram[j], 0, memory_order_relaxed);
+            }
+        }
+    }
+    g_mutex_unlock(&threads_lock);
+}
+
+JNIEXPORT jobjectArray JNICALL Java_snd_komelia_image_NativeStageStats_snapshot(
+    JNIEnv *env,
+    jobject this
+) {
+    KomeliaStageStats stats[KOMELIA_STAGE_COUNT];
+    komelia_stage_stats_snapshot(stats);
+
+    jclass jvm_stage_class = (*env)->FindClass(env, "snd/komelia/image/NativeStageStats$Stage");
+    jmethodID constructor = (*env)->GetMethodID(env, jvm_stage_class, "<init>", "(Ljava/lang/String;JJJ[J)V");
+    jobjectArray jvm_stages = (*env)->NewObjectArray(env, KOMELIA_STAGE_COUNT, jvm_stage_class, nullptr);
+    for (int i = 0; i < KOMELIA_STAGE_COUNT; ++i) {
+        jlongArray jvm_histogram = (*env)->NewLongArray(env, KOMELIA_STAGE_HISTOGRAM_BUCKETS);
+        (*env)->SetLongArrayRegion(
+            env,
+            jvm_histogram,
+            0,
+            KOMELIA_STAGE_HISTOGRAM_BUCKETS,
+            (const jlong *)stats[i].histogram
+        );
+        jstring jvm_name = (*env)->NewStringUTF(env, stage_names[i]);
+        jobject jvm_stage = (*env)->NewObject(
+            env,
+            jvm_stage_class,
+            constructor,
+            jvm_name,
+            (int64_t)stats[i].count,
+            (int64_t)stats[i].total_us,
+            (int64_t)stats[i].max_us,
+            jvm_histogram
+        );
+        (*env)->SetObjectArrayElement(env, jvm_stages, i, jvm_stage);
+        (*env)->DeleteLocalRef(env, jvm_histogram);
+        (*env)->DeleteLocalRef(env, jvm_name);
+        (*env)->DeleteLocalRef(env, jvm_stage);
+    }
+    return jvm_stages;
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_image_NativeStageStats_reset(
+    JNIEnv *env,
+    jobject this
+) {
+    komelia_stage_stats_reset();
+}
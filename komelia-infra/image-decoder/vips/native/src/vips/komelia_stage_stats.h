@@ -0,0 +1,65 @@
+#ifndef KOMELIA_STAGE_STATS_H
+#define KOMELIA_STAGE_STATS_H
+
+#include <jni.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Wall time spent in hot path stages. Accumulated for the whole process lifetime until reset.
+// Vips pipelines are lazy: decode and colourspace stages only cover pipeline setup,
+// pixels are decoded and converted during render. Render time minus bitmap copy is pixel decode time
+typedef enum {
+    KOMELIA_STAGE_VIPS_DECODE = 0,
+    KOMELIA_STAGE_VIPS_COLOURSPACE = 1,
+    KOMELIA_STAGE_VIPS_RENDER = 2,
+    KOMELIA_STAGE_VIPS_BITMAP_COPY = 3,
+    KOMELIA_STAGE_UPSCALE_PREPROCESS = 4,
+    KOMELIA_STAGE_UPSCALE_TILE_FETCH = 5,
+    KOMELIA_STAGE_UPSCALE_TENSOR_BUILD = 6,
+    KOMELIA_STAGE_UPSCALE_RUN = 7,
+    KOMELIA_STAGE_UPSCALE_POSTPROCESS = 8,
+    KOMELIA_STAGE_UPSCALE_JOIN = 9,
+    KOMELIA_STAGE_RF_DETR_PREPROCESS = 10,
+    KOMELIA_STAGE_RF_DETR_RUN = 11,
+    KOMELIA_STAGE_RF_DETR_POSTPROCESS = 12,
+    // decoder waiting for encoded bytes of a streamed image
+    KOMELIA_STAGE_STREAM_READ = 13,
+    KOMELIA_STAGE_COUNT
+} KomeliaStage;
+
+// bucket i counts durations in [2^i, 2^(i+1)) microseconds, first bucket also includes 0.
+// Last bucket counts everything above ~8 seconds
+#define KOMELIA_STAGE_HISTOGRAM_BUCKETS 24
+
+typedef struct {
+    uint64_t count;
+    uint64_t total_us;
+    uint64_t max_us;
+    uint64_t histogram[KOMELIA_STAGE_HISTOGRAM_BUCKETS];
+} KomeliaStageStats;
+
+// returns monotonic timestamp passed to komelia_stage_end
+JNIEXPORT int64_t komelia_stage_start();
+
+// records duration in accumulator of the calling thread. Does not take locks
+// except for the first call on a new thread
+JNIEXPORT void komelia_stage_end(
+    KomeliaStage stage,
+    int64_t start
+);
+
+JNIEXPORT const char *komelia_stage_name(KomeliaStage stage);
+
+// sums accumulators of all threads. stats must have space for KOMELIA_STAGE_COUNT entries
+JNIEXPORT void komelia_stage_stats_snapshot(KomeliaStageStats *stats);
+
+JNIEXPORT void komelia_stage_stats_reset();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // KOMELIA_STAGE_STATS_H
@@ -0,0 +1,270 @@
+#include "vips_common_jni.h"
+
+// decoded thumbnails waiting for jvm callback per worker thread.
+// Workers stop decoding when consumer falls behind to keep memory bounded
+#define MAX_PENDING_RESULTS_PER_THREAD 2
+
+typedef struct {
+    int width;
+    int height;
+    bool crop;
+    GAsyncQueue *results;
+
+    GMutex lock;
+    GCond slot_available;
+    int pending_results;
+    int max_pending_results;
+    gint cancelled;
+} ThumbnailBatch;
+
+typedef struct {
+    ThumbnailBatch *batch;
+    int index;
+    char *path;
+    unsigned char *buffer;
+    size_t buffer_len;
+} ThumbnailTask;
+
+typedef struct {
+    int index;
+    VipsImage *image;
+    char *error;
+    bool holds_slot;
+} ThumbnailResult;
+
+static GThreadPool *thumbnail_pool = nullptr;
+static GOnce thumbnail_pool_once = G_ONCE_INIT;
+
+static bool acquire_result_slot(ThumbnailBatch *batch) {
+    g_mutex_lock(&batch->lock);
+    while (batch->pending_results >= batch->max_pending_results && !g_atomic_int_get(&batch->cancelled)) {
+        g_cond_wait(&batch->slot_available, &batch->lock);
+    }
+    bool acquired = !g_atomic_int_get(&batch->cancelled);
+    if (acquired) {
+        ++batch->pending_results;
+    }
+    g_mutex_unlock(&batch->lock);
+    return acquired;
+}
+
+static void release_result_slot(ThumbnailBatch *batch) {
+    g_mutex_lock(&batch->lock);
+    --batch->pending_results;
+    g_cond_signal(&batch->slot_available);
+    g_mutex_unlock(&batch->lock);
+}
+
+static VipsImage *create_thumbnail(ThumbnailTask *task) {
+    ThumbnailBatch *batch = task->batch;
+    VipsImage *thumbnail = nullptr;
+    int vips_error;
+    if (task->path != nullptr) {
+        vips_error = batch->crop
+                         ? vips_thumbnail(task->path, &thumbnail, batch->width, "height", batch->height,
+                                          "crop", VIPS_INTERESTING_ENTROPY, nullptr)
+                         : vips_thumbnail(task->path, &thumbnail, batch->width, "height", batch->height, nullptr);
+    } else {
+        vips_error = batch->crop
+                         ? vips_thumbnail_buffer(task->buffer, task->buffer_len, &thumbnail, batch->width,
+                                                 "height", batch->height, "crop", VIPS_INTERESTING_ENTROPY, nullptr)
+                         : vips_thumbnail_buffer(task->buffer, task->buffer_len, &thumbnail, batch->width,
+                                                 "height", batch->height, nullptr);
+    }
+    if (vips_error)
+        return nullptr;
+
+    // decode on the worker thread. Result must not reference task input that is freed afterward
+    VipsImage *decoded = vips_image_copy_memory(thumbnail);
+    g_object_unref(thumbnail);
+    return decoded;
+}
+
+static void run_thumbnail_task(
+    gpointer data,
+    gpointer user_data
+) {
+    ThumbnailTask *task = data;
+    ThumbnailBatch *batch = task->batch;
+    ThumbnailResult *result = calloc(1, sizeof(ThumbnailResult));
+    result->index = task->index;
+
+    if (acquire_result_slot(batch)) {
+        result->holds_slot = true;
+        result->image = create_thumbnail(task);
+        // vips error buffer is shared by all threads and would mix messages of parallel tasks
+        if (result->image == nullptr && task->path != nullptr) {
+            result->error = g_strdup_printf("failed to create thumbnail of %s", task->path);
+        } else if (result->image == nullptr) {
+            result->error = g_strdup_printf("failed to create thumbnail of image %d", task->index);
+        }
+    }
+
+    g_free(task->path);
+    free(task->buffer);
+    free(task);
+
+    GAsyncQueue *results = g_async_queue_ref(batch->results);
+    g_async_queue_push(results, result);
+    g_async_queue_unref(results);
+    vips_thread_shutdown();
+}
+
+static gpointer create_thumbnail_pool(gpointer data) {
+    return g_thread_pool_new(run_thumbnail_task, nullptr, g_get_num_processors(), FALSE, nullptr);
+}
+
+static void cancel_batch(ThumbnailBatch *batch) {
+    g_mutex_lock(&batch->lock);
+    g_atomic_int_set(&batch->cancelled, 1);
+    g_cond_broadcast(&batch->slot_available);
+    g_mutex_unlock(&batch->lock);
+}
+
+// passes results to the callback on the calling thread as soon as workers finish them.
+// If callback throws, remaining tasks are cancelled and exception is propagated to the caller
+static void deliver_results(
+    JNIEnv *env,
+    ThumbnailBatch *batch,
+    int count,
+    jobject callback
+) {
+    jclass callback_class = (*env)->GetObjectClass(env, callback);
+    jmethodID callback_method = (*env)->GetMethodID(
+        env,
+        callback_class,
+        "onThumbnail",
+        "(ILsnd/komelia/image/VipsImage;Ljava/lang/String;)V"
+    );
+
+    for (int received = 0; received < count; ++received) {
+        ThumbnailResult *result = g_async_queue_pop(batch->results);
+        bool cancelled = g_atomic_int_get(&batch->cancelled);
+
+        if (cancelled) {
+            if (result->image != nullptr)
+                g_object_unref(result->image);
+        } else {
+            jobject jvm_image = nullptr;
+            jstring jvm_error = nullptr;
+            if (result->image != nullptr) {
+                jvm_image = komelia_to_jvm_handle(env, result->image, nullptr);
+                if (jvm_image == nullptr) {
+                    (*env)->ExceptionClear(env);
+                    g_object_unref(result->image);
+                    jvm_error = (*env)->NewStringUTF(env, "unsupported thumbnail format");
+                }
+            } else if (result->error != nullptr) {
+                jvm_error = (*env)->NewStringUTF(env, result->error);
+            }
+
+            (*env)->CallVoidMethod(env, callback, callback_method, result->index, jvm_image, jvm_error);
+            if ((*env)->ExceptionCheck(env)) {
+                cancel_batch(batch);
+            }
+
+            if (jvm_image != nullptr)
+                (*env)->DeleteLocalRef(env, jvm_image);
+            if (jvm_error != nullptr)
+                (*env)->DeleteLocalRef(env, jvm_error);
+        }
+
+        if (result->holds_slot)
+            release_result_slot(batch);
+        g_free(result->error);
+        free(result);
+    }
+}
+
+static ThumbnailBatch *new_batch(
+    int width,
+    int height,
+    bool crop
+) {
+    thumbnail_pool = g_once(&thumbnail_pool_once, create_thumbnail_pool, nullptr);
+
+    ThumbnailBatch *batch = malloc(sizeof(ThumbnailBatch));
+    batch->width = width;
+    batch->height = height;
+    batch->crop = crop;
+    batch->results = g_async_queue_new();
+    g_mutex_init(&batch->lock);
+    g_cond_init(&batch->slot_available);
+    batch->pending_results = 0;
+    batch->max_pending_results = MAX_PENDING_RESULTS_PER_THREAD * g_get_num_processors();
+    batch->cancelled = 0;
+    return batch;
+}
+
+// safe to call only after all task results were received
+static void free_batch(ThumbnailBatch *batch) {
+    g_async_queue_unref(batch->results);
+    g_mutex_clear(&batch->lock);
+    g_cond_clear(&batch->slot_available);
+    free(batch);
+}
+
+static ThumbnailTask *new_task(
+    ThumbnailBatch *batch,
+    int index
+) {
+    ThumbnailTask *task = calloc(1, sizeof(ThumbnailTask));
+    task->batch = batch;
+    task->index = index;
+    return task;
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_image_VipsImage_thumbnailBatch(
+    JNIEnv *env,
+    jobject this,
+    jobjectArray paths,
+    jint scale_width,
+    jint scale_height,
+    jboolean crop,
+    jobject callback
+) {
+    jsize count = (*env)->GetArrayLength(env, paths);
+    ThumbnailBatch *batch = new_batch(scale_width, scale_height, crop);
+
+    for (int i = 0; i < count; ++i) {
+        jstring path = (*env)->GetObjectArrayElement(env, paths, i);
+        const char *path_chars = (*env)->GetStringUTFChars(env, path, nullptr);
+        ThumbnailTask *task = new_task(batch, i);
+        task->path = g_strdup(path_chars);
+        (*env)->ReleaseStringUTFChars(env, path, path_chars);
+        (*env)->DeleteLocalRef(env, path);
+
+        g_thread_pool_push(thumbnail_pool, task, nullptr);
+    }
+
+    deliver_results(env, batch, count, callback);
+    free_batch(batch);
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_image_VipsImage_thumbnailBufferBatch(
+    JNIEnv *env,
+    jobject this,
+    jobjectArray encoded_array,
+    jint scale_width,
+    jint scale_height,
+    jboolean crop,
+    jobject callback
+) {
+    jsize count = (*env)->GetArrayLength(env, encoded_array);
+    ThumbnailBatch *batch = new_batch(scale_width, scale_height, crop);
+
+    for (int i = 0; i < count; ++i) {
+        jbyteArray encoded = (*env)->GetObjectArrayElement(env, encoded_array, i);
+        jsize input_len = (*env)->GetArrayLength(env, encoded);
+        ThumbnailTask *task = new_task(batch, i);
+        task->buffer = malloc(input_len * sizeof(unsigned char));
+        task->buffer_len = input_len;
+        (*env)->GetByteArrayRegion(env, encoded, 0, input_len, (jbyte *)task->buffer);
+        (*env)->DeleteLocalRef(env, encoded);
+
+        g_thread_pool_push(thumbnail_pool, task, nullptr);
+    }
+
+    deliver_results(env, batch, count, callback);
+    free_batch(batch);
+}
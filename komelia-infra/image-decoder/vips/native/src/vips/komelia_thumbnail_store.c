@@ -0,0 +1,473 @@
+#include "komelia_thumbnail_store.h"
+#include "vips_common_jni.h"
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define store_fseek _fseeki64
+#define store_ftell _ftelli64
+#else
+#define store_fseek fseeko
+#define store_ftell ftello
+#endif
+
+#define INDEX_FILE_NAME "thumbnails.idx"
+#define PACK_FILE_NAME "thumbnails.pack"
+#define INDEX_MAGIC 0x4948544b // "KTHI"
+#define INDEX_VERSION 2
+
+#define RECORD_FLAG_OPAQUE 1u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t reserved;
+} IndexHeader;
+
+// fixed size index entry. Later entries for the same key replace earlier ones.
+// Entry with zero size removes the key.
+// Pack data at offset starts with key bytes followed by pixels
+typedef struct {
+    uint64_t key_hash;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bands;
+    uint32_t interpretation;
+    uint32_t flags;
+    uint32_t key_length;
+} ThumbnailRecord;
+
+struct KomeliaThumbnailStore {
+    GMutex lock;
+    GHashTable *records;
+    FILE *index_file;
+    FILE *pack_file;
+};
+
+// FNV-1a
+static uint64_t hash_key(const char *key) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const unsigned char *c = (const unsigned char *)key; *c != '\0'; ++c) {
+        hash ^= *c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static void apply_record(
+    GHashTable *records,
+    const ThumbnailRecord *record
+) {
+    if (record->size == 0) {
+        g_hash_table_remove(records, &record->key_hash);
+        return;
+    }
+
+    ThumbnailRecord *copy = g_memdup2(record, sizeof(ThumbnailRecord));
+    g_hash_table_replace(records, &copy->key_hash, copy);
+}
+
+// hash only selects the record; stored key bytes decide if it belongs to the key.
+// Leaves pack file positioned at the start of pixels. Must be called with store lock held
+static bool record_matches_key(
+    KomeliaThumbnailStore *store,
+    const ThumbnailRecord *record,
+    const char *key,
+    size_t key_length
+) {
+    if (record->key_length != key_length)
+        return false;
+
+    char *stored_key = g_malloc(key_length);
+    store_fseek(store->pack_file, (int64_t)record->offset, SEEK_SET);
+    bool matches = fread(stored_key, 1, key_length, store->pack_file) == key_length &&
+                   memcmp(stored_key, key, key_length) == 0;
+    g_free(stored_key);
+    return matches;
+}
+
+// index is read through a read-only mapping in a single sequential pass.
+// Returns 1 if index was written in a different format and store has to be reset
+static int load_index(
+    KomeliaThumbnailStore *store,
+    const char *index_path,
+    uint64_t pack_size
+) {
+    if (!g_file_test(index_path, G_FILE_TEST_EXISTS))
+        return 0;
+
+    GError *error = nullptr;
+    GMappedFile *mapped = g_mapped_file_new(index_path, FALSE, &error);
+    if (mapped == nullptr) {
+        vips_error("komelia", "failed to map thumbnail index: %s", error->message);
+        g_error_free(error);
+        return -1;
+    }
+
+    size_t length = g_mapped_file_get_length(mapped);
+    const char *contents = g_mapped_file_get_contents(mapped);
+    if (length < sizeof(IndexHeader)) {
+        g_mapped_file_unref(mapped);
+        return 0;
+    }
+
+    const IndexHeader *header = (const IndexHeader *)contents;
+    if (header->magic != INDEX_MAGIC || header->version != INDEX_VERSION) {
+        g_mapped_file_unref(mapped);
+        return 1;
+    }
+
+    // partially written trailing record is ignored
+    size_t record_count = (length - sizeof(IndexHeader)) / sizeof(ThumbnailRecord);
+    const ThumbnailRecord *records = (const ThumbnailRecord *)(contents + sizeof(IndexHeader));
+    for (size_t i = 0; i < record_count; ++i) {
+        const ThumbnailRecord *record = &records[i];
+        // skip entries whose pixels didn't make it to the pack file
+        if (record->offset + record->key_length + record->size > pack_size)
+            continue;
+        apply_record(store->records, record);
+    }
+
+    g_mapped_file_unref(mapped);
+    return 0;
+}
+
+static bool open_files(
+    KomeliaThumbnailStore *store,
+    const char *index_path,
+    const char *pack_path
+) {
+    // "a+" keeps every write at the end of the file while still allowing reads at any offset
+    store->pack_file = fopen(pack_path, "a+b");
+    store->index_file = fopen(index_path, "a+b");
+    return store->pack_file != nullptr && store->index_file != nullptr;
+}
+
+static void close_files(KomeliaThumbnailStore *store) {
+    if (store->index_file != nullptr)
+        fclose(store->index_file);
+    if (store->pack_file != nullptr)
+        fclose(store->pack_file);
+    store->index_file = nullptr;
+    store->pack_file = nullptr;
+}
+
+KomeliaThumbnailStore *komelia_thumbnail_store_open(const char *directory) {
+    if (g_mkdir_with_parents(directory, 0755)) {
+        vips_error("komelia", "failed to create thumbnail store directory %s", directory);
+        return nullptr;
+    }
+
+    char *index_path = g_build_filename(directory, INDEX_FILE_NAME, nullptr);
+    char *pack_path = g_build_filename(directory, PACK_FILE_NAME, nullptr);
+
+    KomeliaThumbnailStore *store = calloc(1, sizeof(KomeliaThumbnailStore));
+    g_mutex_init(&store->lock);
+    store->records = g_hash_table_new_full(g_int64_hash, g_int64_equal, nullptr, g_free);
+
+    if (!open_files(store, index_path, pack_path)) {
+        vips_error("komelia", "failed to open thumbnail store files in %s", directory);
+        goto fail;
+    }
+
+    store_fseek(store->pack_file, 0, SEEK_END);
+    uint64_t pack_size = store_ftell(store->pack_file);
+    int load_result = load_index(store, index_path, pack_size);
+    if (load_result < 0)
+        goto fail;
+
+    // thumbnails can always be recreated, start over instead of migrating older formats
+    if (load_result > 0) {
+        close_files(store);
+        g_remove(index_path);
+        g_remove(pack_path);
+        if (!open_files(store, index_path, pack_path)) {
+            vips_error("komelia", "failed to open thumbnail store files in %s", directory);
+            goto fail;
+        }
+    }
+
+    store_fseek(store->index_file, 0, SEEK_END);
+    if (store_ftell(store->index_file) < (int64_t)sizeof(IndexHeader)) {
+        IndexHeader header = {.magic = INDEX_MAGIC, .version = INDEX_VERSION, .reserved = 0};
+        fwrite(&header, sizeof(IndexHeader), 1, store->index_file);
+        fflush(store->index_file);
+    }
+
+    g_free(index_path);
+    g_free(pack_path);
+    return store;
+
+fail:
+    g_free(index_path);
+    g_free(pack_path);
+    komelia_thumbnail_store_close(store);
+    return nullptr;
+}
+
+void komelia_thumbnail_store_close(KomeliaThumbnailStore *store) {
+    close_files(store);
+    g_hash_table_unref(store->records);
+    g_mutex_clear(&store->lock);
+    free(store);
+}
+
+int komelia_thumbnail_store_get(
+    KomeliaThumbnailStore *store,
+    const char *key,
+    VipsImage **image,
+    unsigned char **pixels
+) {
+    *image = nullptr;
+    *pixels = nullptr;
+    uint64_t key_hash = hash_key(key);
+    size_t key_length = strlen(key);
+
+    g_mutex_lock(&store->lock);
+    ThumbnailRecord *found = g_hash_table_lookup(store->records, &key_hash);
+    if (found == nullptr || !record_matches_key(store, found, key, key_length)) {
+        g_mutex_unlock(&store->lock);
+        return 0;
+    }
+    ThumbnailRecord record = *found;
+
+    unsigned char *data = malloc(record.size);
+    if (data == nullptr) {
+        g_mutex_unlock(&store->lock);
+        vips_error("komelia", "failed to allocate %zu bytes for thumbnail pixels", (size_t)record.size);
+        return -1;
+    }
+    size_t read = fread(data, 1, record.size, store->pack_file);
+    g_mutex_unlock(&store->lock);
+
+    if (read != record.size) {
+        free(data);
+        vips_error("komelia", "failed to read thumbnail pixels");
+        return -1;
+    }
+
+    VipsImage *raw = vips_image_new_from_memory(
+        data,
+        record.size,
+        (int)record.width,
+        (int)record.height,
+        (int)record.bands,
+        VIPS_FORMAT_UCHAR
+    );
+    if (raw == nullptr) {
+        free(data);
+        return -1;
+    }
+
+    VipsImage *copy = nullptr;
+    int copy_error = vips_copy(raw, &copy, "interpretation", record.interpretation, nullptr);
+    g_object_unref(raw);
+    if (copy_error) {
+        free(data);
+        return -1;
+    }
+    if (record.flags & RECORD_FLAG_OPAQUE) {
+        vips_image_set_int(copy, KOMELIA_META_OPAQUE, 1);
+    }
+
+    *image = copy;
+    *pixels = data;
+    return 0;
+}
+
+int komelia_thumbnail_store_put(
+    KomeliaThumbnailStore *store,
+    const char *key,
+    VipsImage *image
+) {
+    if (vips_image_get_format(image) != VIPS_FORMAT_UCHAR) {
+        vips_error("komelia", "only 8 bit images can be stored");
+        return -1;
+    }
+
+    // render outside of the lock
+    size_t size = 0;
+    void *pixels = vips_image_write_to_memory(image, &size);
+    if (pixels == nullptr)
+        return -1;
+
+    size_t key_length = strlen(key);
+    ThumbnailRecord record = {
+        .key_hash = hash_key(key),
+        .size = size,
+        .width = vips_image_get_width(image),
+        .height = vips_image_get_height(image),
+        .bands = vips_image_get_bands(image),
+        .interpretation = vips_image_get_interpretation(image),
+        .flags = komelia_image_is_opaque(image) ? RECORD_FLAG_OPAQUE : 0,
+        .key_length = key_length,
+    };
+
+    // on hash collision the newer key replaces older one, older key becomes a miss
+    g_mutex_lock(&store->lock);
+    store_fseek(store->pack_file, 0, SEEK_END);
+    record.offset = store_ftell(store->pack_file);
+    bool written = fwrite(key, 1, key_length, store->pack_file) == key_length &&
+                   fwrite(pixels, 1, size, store->pack_file) == size &&
+                   fflush(store->pack_file) == 0;
+
+    // index entry is written only after pixels are flushed
+    if (written) {
+        written = fwrite(&record, sizeof(ThumbnailRecord), 1, store->index_file) == 1 &&
+                  fflush(store->index_file) == 0;
+    }
+    if (written) {
+        apply_record(store->records, &record);
+    }
+    g_mutex_unlock(&store->lock);
+    g_free(pixels);
+
+    if (!written) {
+        vips_error("komelia", "failed to write thumbnail");
+        return -1;
+    }
+    return 0;
+}
+
+int komelia_thumbnail_store_remove(
+    KomeliaThumbnailStore *store,
+    const char *key
+) {
+    ThumbnailRecord record = {0};
+    record.key_hash = hash_key(key);
+
+    g_mutex_lock(&store->lock);
+    // don't remove entry of a different key with colliding hash
+    ThumbnailRecord *found = g_hash_table_lookup(store->records, &record.key_hash);
+    if (found == nullptr || !record_matches_key(store, found, key, strlen(key))) {
+        g_mutex_unlock(&store->lock);
+        return 0;
+    }
+
+    bool written = fwrite(&record, sizeof(ThumbnailRecord), 1, store->index_file) == 1 &&
+                   fflush(store->index_file) == 0;
+    apply_record(store->records, &record);
+    g_mutex_unlock(&store->lock);
+
+    if (!written) {
+        vips_error("komelia", "failed to write thumbnail index");
+        return -1;
+    }
+    return 0;
+}
+
+static KomeliaThumbnailStore *get_store_from_jvm_handle(
+    JNIEnv *env,
+    jobject jvm_store
+) {
+    jclass class = (*env)->GetObjectClass(env, jvm_store);
+    jfieldID ptr_field = (*env)->GetFieldID(env, class, "_ptr", "J");
+    KomeliaThumbnailStore *store = (KomeliaThumbnailStore *)(*env)->GetLongField(env, jvm_store, ptr_field);
+    if (store == nullptr) {
+        komelia_throw_jvm_vips_exception_message(env, "thumbnail store was already closed");
+    }
+    return store;
+}
+
+JNIEXPORT jlong JNICALL Java_snd_komelia_image_VipsThumbnailStore_openStore(
+    JNIEnv *env,
+    jobject this,
+    jstring directory
+) {
+    const char *directory_chars = (*env)->GetStringUTFChars(env, directory, nullptr);
+    KomeliaThumbnailStore *store = komelia_thumbnail_store_open(directory_chars);
+    (*env)->ReleaseStringUTFChars(env, directory, directory_chars);
+
+    if (store == nullptr) {
+        komelia_throw_jvm_vips_exception(env);
+        return 0;
+    }
+    return (int64_t)store;
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_image_VipsThumbnailStore_destroy(
+    JNIEnv *env,
+    jobject this,
+    jlong ptr
+) {
+    komelia_thumbnail_store_close((KomeliaThumbnailStore *)ptr);
+}
+
+JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsThumbnailStore_get(
+    JNIEnv *env,
+    jobject this,
+    jstring key
+) {
+    KomeliaThumbnailStore *store = get_store_from_jvm_handle(env, this);
+    if (store == nullptr)
+        return nullptr;
+
+    const char *key_chars = (*env)->GetStringUTFChars(env, key, nullptr);
+    VipsImage *image = nullptr;
+    unsigned char *pixels = nullptr;
+    int read_error = komelia_thumbnail_store_get(store, key_chars, &image, &pixels);
+    (*env)->ReleaseStringUTFChars(env, key, key_chars);
+
+    if (read_error) {
+        komelia_throw_jvm_vips_exception(env);
+        vips_thread_shutdown();
+        return nullptr;
+    }
+    if (image == nullptr) {
+        vips_thread_shutdown();
+        return nullptr;
+    }
+
+    // pixels are released together with jvm image
+    jobject jvm_image = komelia_to_jvm_handle(env, image, pixels);
+    if (jvm_image == nullptr) {
+        g_object_unref(image);
+        free(pixels);
+    }
+    vips_thread_shutdown();
+    return jvm_image;
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_image_VipsThumbnailStore_put(
+    JNIEnv *env,
+    jobject this,
+    jstring key,
+    jobject jvm_image
+) {
+    KomeliaThumbnailStore *store = get_store_from_jvm_handle(env, this);
+    if (store == nullptr)
+        return;
+    VipsImage *image = komelia_from_jvm_handle(env, jvm_image);
+    if (image == nullptr)
+        return;
+
+    const char *key_chars = (*env)->GetStringUTFChars(env, key, nullptr);
+    int put_error = komelia_thumbnail_store_put(store, key_chars, image);
+    (*env)->ReleaseStringUTFChars(env, key, key_chars);
+
+    if (put_error) {
+        komelia_throw_jvm_vips_exception(env);
+    }
+    vips_thread_shutdown();
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_image_VipsThumbnailStore_remove(
+    JNIEnv *env,
+    jobject this,
+    jstring key
+) {
+    KomeliaThumbnailStore *store = get_store_from_jvm_handle(env, this);
+    if (store == nullptr)
+        return;
+
+    const char *key_chars = (*env)->GetStringUTFChars(env, key, nullptr);
+    int remove_error = komelia_thumbnail_store_remove(store, key_chars);
+    (*env)->ReleaseStringUTFChars(env, key, key_chars);
+
+    if (remove_error) {
+        komelia_throw_jvm_vips_exception(env);
+    }
+}
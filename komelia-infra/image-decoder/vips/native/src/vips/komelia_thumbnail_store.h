@@ -0,0 +1,37 @@
+#ifndef KOMELIA_THUMBNAIL_STORE_H
+#define KOMELIA_THUMBNAIL_STORE_H
+
+#include <vips/vips.h>
+
+// Persistent store of decoded thumbnails.
+// Pixels are appended to a pack file, index of pack offsets is an append-only log
+// that is mapped and loaded into a hash table when store is opened.
+// Key bytes are stored in front of pixels and checked on lookup
+typedef struct KomeliaThumbnailStore KomeliaThumbnailStore;
+
+// returns nullptr and sets vips error on failure
+KomeliaThumbnailStore *komelia_thumbnail_store_open(const char *directory);
+
+void komelia_thumbnail_store_close(KomeliaThumbnailStore *store);
+
+// sets image backed by pixels buffer or nullptr if there's no entry for the key.
+// pixels must be freed by the caller after the image is released. Returns non-zero on read error
+int komelia_thumbnail_store_get(
+    KomeliaThumbnailStore *store,
+    const char *key,
+    VipsImage **image,
+    unsigned char **pixels
+);
+
+int komelia_thumbnail_store_put(
+    KomeliaThumbnailStore *store,
+    const char *key,
+    VipsImage *image
+);
+
+int komelia_thumbnail_store_remove(
+    KomeliaThumbnailStore *store,
+    const char *key
+);
+
+#endif // KOMELIA_THUMBNAIL_STORE_H
@@ -1,4 +1,7 @@
 #include "vips_common_jni.h"
+#include "komelia_stage_stats.h"
+#include <glib/gstdio.h>
+#include <math.h>
 
 JNIEXPORT void JNICALL Java_snd_komelia_image_VipsImage_vipsInit() {
     VIPS_INIT("komelia");
@@ -21,13 +24,12 @@ JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_decode(
     jobject n_pages
 ) {
     jsize input_len = (*env)->GetArrayLength(env, encoded);
-    jbyte *input_bytes = (*env)->GetByteArrayElements(env, encoded, nullptr);
-
+    // copy straight into the buffer owned by the image instead of pinning the jvm array first
     unsigned char *internal_buffer = malloc(input_len * sizeof(unsigned char));
-    memcpy(internal_buffer, input_bytes, input_len);
-    (*env)->ReleaseByteArrayElements(env, encoded, input_bytes, JNI_ABORT);
+    (*env)->GetByteArrayRegion(env, encoded, 0, input_len, (jbyte *)internal_buffer);
 
     VipsImage *decoded;
+    int64_t decode_start = komelia_stage_start();
     if (n_pages != nullptr) {
         decoded = vips_image_new_from_buffer(
             internal_buffer,
@@ -40,22 +42,219 @@ JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_decode(
     } else {
         decoded = vips_image_new_from_buffer(internal_buffer, input_len, "", nullptr);
     }
+    komelia_stage_end(KOMELIA_STAGE_VIPS_DECODE, decode_start);
+
+    if (!decoded) {
+        komelia_throw_jvm_vips_exception(env);
+        vips_thread_shutdown();
+        return nullptr;
+    }
+
+    jobject jvm_image = komelia_to_jvm_handle(env, decoded, internal_buffer);
+    if (jvm_image == nullptr) {
+        g_object_unref(decoded);
+    }
+
+    vips_thread_shutdown();
+    return jvm_image;
+}
+
+#define KOMELIA_META_ORIGINAL_WIDTH "komelia-original-width"
+#define KOMELIA_META_ORIGINAL_HEIGHT "komelia-original-height"
+
+// largest integer shrink that keeps image at or above target size in both dimensions
+static int get_display_shrink(
+    VipsImage *header,
+    int target_width,
+    int target_height
+) {
+    if (target_width <= 0 || target_height <= 0)
+        return 1;
+
+    double shrink = fmin(
+        (double)vips_image_get_width(header) / target_width,
+        (double)vips_image_get_page_height(header) / target_height
+    );
+    return shrink < 2.0 ? 1 : (int)floor(shrink);
+}
+
+static bool is_loaded_by(
+    VipsImage *header,
+    const char *loader_prefix
+) {
+    const char *loader = nullptr;
+    if (!vips_image_get_typeof(header, VIPS_META_LOADER) ||
+        vips_image_get_string(header, VIPS_META_LOADER, &loader)) {
+        return false;
+    }
+    return vips_isprefix(loader_prefix, loader);
+}
+
+// libjpeg-turbo can only shrink by 2, 4 or 8 during decode
+static int to_jpeg_shrink(int shrink) {
+    if (shrink >= 8)
+        return 8;
+    if (shrink >= 4)
+        return 4;
+    if (shrink >= 2)
+        return 2;
+    return 1;
+}
+
+static void set_original_size(
+    VipsImage *image,
+    VipsImage *header
+) {
+    vips_image_set_int(image, KOMELIA_META_ORIGINAL_WIDTH, vips_image_get_width(header));
+    vips_image_set_int(image, KOMELIA_META_ORIGINAL_HEIGHT, vips_image_get_page_height(header));
+}
+
+// header is opened lazily and pixels are not decoded at this point.
+// If format supports shrink-on-load, image is reopened at reduced resolution, otherwise header image is returned as is
+static VipsImage *load_buffer_for_display(
+    const unsigned char *buffer,
+    size_t buffer_len,
+    int target_width,
+    int target_height
+) {
+    VipsImage *header = vips_image_new_from_buffer(buffer, buffer_len, "", nullptr);
+    if (header == nullptr)
+        return nullptr;
+
+    int shrink = get_display_shrink(header, target_width, target_height);
+    VipsImage *reduced = nullptr;
+    if (shrink > 1 && is_loaded_by(header, "jpegload")) {
+        reduced = vips_image_new_from_buffer(buffer, buffer_len, "", "shrink", to_jpeg_shrink(shrink), nullptr);
+    } else if (shrink > 1 && is_loaded_by(header, "webpload")) {
+        reduced = vips_image_new_from_buffer(buffer, buffer_len, "", "scale", 1.0 / shrink, nullptr);
+    }
+
+    if (reduced == nullptr) {
+        // shrink-on-load is an optimization, fall back to full resolution decode
+        vips_error_clear();
+        return header;
+    }
+
+    set_original_size(reduced, header);
+    g_object_unref(header);
+    return reduced;
+}
+
+static VipsImage *load_file_for_display(
+    const char *path,
+    int target_width,
+    int target_height
+) {
+    VipsImage *header = vips_image_new_from_file(path, nullptr);
+    if (header == nullptr)
+        return nullptr;
+
+    int shrink = get_display_shrink(header, target_width, target_height);
+    VipsImage *reduced = nullptr;
+    if (shrink > 1 && is_loaded_by(header, "jpegload")) {
+        reduced = vips_image_new_from_file(path, "shrink", to_jpeg_shrink(shrink), nullptr);
+    } else if (shrink > 1 && is_loaded_by(header, "webpload")) {
+        reduced = vips_image_new_from_file(path, "scale", 1.0 / shrink, nullptr);
+    }
+
+    if (reduced == nullptr) {
+        vips_error_clear();
+        return header;
+    }
+
+    set_original_size(reduced, header);
+    g_object_unref(header);
+    return reduced;
+}
+
+// decodes image at the lowest resolution that still covers target size
+JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_decodeForDisplay(
+    JNIEnv *env,
+    jobject this,
+    jbyteArray encoded,
+    jint target_width,
+    jint target_height
+) {
+    jsize input_len = (*env)->GetArrayLength(env, encoded);
+    unsigned char *internal_buffer = malloc(input_len * sizeof(unsigned char));
+    (*env)->GetByteArrayRegion(env, encoded, 0, input_len, (jbyte *)internal_buffer);
 
+    int64_t decode_start = komelia_stage_start();
+    VipsImage *decoded = load_buffer_for_display(internal_buffer, input_len, target_width, target_height);
+    komelia_stage_end(KOMELIA_STAGE_VIPS_DECODE, decode_start);
     if (!decoded) {
         komelia_throw_jvm_vips_exception(env);
         vips_thread_shutdown();
+        free(internal_buffer);
         return nullptr;
     }
 
     jobject jvm_image = komelia_to_jvm_handle(env, decoded, internal_buffer);
     if (jvm_image == nullptr) {
         g_object_unref(decoded);
+        free(internal_buffer);
     }
 
     vips_thread_shutdown();
     return jvm_image;
 }
 
+JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_decodeFromFileForDisplay(
+    JNIEnv *env,
+    jobject this,
+    jstring path,
+    jint target_width,
+    jint target_height
+) {
+    const char *path_chars = (*env)->GetStringUTFChars(env, path, nullptr);
+    int64_t decode_start = komelia_stage_start();
+    VipsImage *decoded = load_file_for_display(path_chars, target_width, target_height);
+    komelia_stage_end(KOMELIA_STAGE_VIPS_DECODE, decode_start);
+    (*env)->ReleaseStringUTFChars(env, path, path_chars);
+
+    if (!decoded) {
+        komelia_throw_jvm_vips_exception(env);
+        vips_thread_shutdown();
+        return nullptr;
+    }
+
+    jobject jvm_handle = komelia_to_jvm_handle(env, decoded, nullptr);
+    if (jvm_handle == nullptr) {
+        g_object_unref(decoded);
+    }
+    vips_thread_shutdown();
+    return jvm_handle;
+}
+
+// size of the image before shrink-on-load. Same as image size if image was decoded in full resolution
+JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_getOriginalDimensions(
+    JNIEnv *env,
+    jobject this
+) {
+    VipsImage *image = komelia_from_jvm_handle(env, this);
+    if (image == nullptr)
+        return nullptr;
+
+    int width = vips_image_get_width(image);
+    int height = vips_image_get_page_height(image);
+    if (vips_image_get_typeof(image, KOMELIA_META_ORIGINAL_WIDTH) &&
+        vips_image_get_typeof(image, KOMELIA_META_ORIGINAL_HEIGHT)) {
+        vips_image_get_int(image, KOMELIA_META_ORIGINAL_WIDTH, &width);
+        vips_image_get_int(image, KOMELIA_META_ORIGINAL_HEIGHT, &height);
+    }
+
+    jclass jvm_dimensions_class = (*env)->FindClass(env, "snd/komelia/image/ImageDimensions");
+    jmethodID constructor = (*env)->GetMethodID(env, jvm_dimensions_class, "<init>", "(III)V");
+    return (*env)->NewObject(
+        env,
+        jvm_dimensions_class,
+        constructor,
+        width,
+        height,
+        vips_image_get_bands(image)
+    );
+}
+
 JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_decodeFromFile(
     JNIEnv *env,
     jobject this,
@@ -64,12 +263,14 @@ JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_decodeFromFile(
 ) {
     const char *path_chars = (*env)->GetStringUTFChars(env, path, nullptr);
     VipsImage *decoded;
+    int64_t decode_start = komelia_stage_start();
     if (n_pages != nullptr) {
         decoded =
             vips_image_new_from_file(path_chars, "n", boxed_int_to_int(env, n_pages), nullptr);
     } else {
         decoded = vips_image_new_from_file(path_chars, nullptr);
     }
+    komelia_stage_end(KOMELIA_STAGE_VIPS_DECODE, decode_start);
 
     (*env)->ReleaseStringUTFChars(env, path, path_chars);
 
@@ -135,11 +336,9 @@ JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_thumbnailBuffer(
     jboolean crop
 ) {
     jsize input_len = (*env)->GetArrayLength(env, encoded);
-    jbyte *input_bytes = (*env)->GetByteArrayElements(env, encoded, nullptr);
-
+    // copy straight into the buffer owned by the image instead of pinning the jvm array first
     unsigned char *internal_buffer = malloc(input_len * sizeof(unsigned char));
-    memcpy(internal_buffer, input_bytes, input_len);
-    (*env)->ReleaseByteArrayElements(env, encoded, input_bytes, JNI_ABORT);
+    (*env)->GetByteArrayRegion(env, encoded, 0, input_len, (jbyte *)internal_buffer);
 
     VipsImage *thumbnail = nullptr;
     if (crop) {
@@ -226,37 +425,219 @@ JNIEXPORT void JNICALL Java_snd_komelia_image_VipsImage_encodeToFilePng(
     vips_thread_shutdown();
 }
 
-JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_getDimensions(
+// Uncompressed vips native format. Header stores dimensions, bands and all image metadata (page height, delays).
+// vips saver selects format by file extension, file is written with .v suffix and renamed to requested path
+JNIEXPORT void JNICALL Java_snd_komelia_image_VipsImage_encodeToFileVips(
     JNIEnv *env,
     jobject this,
-    jbyteArray encoded
+    jstring path
 ) {
-    jsize input_len = (*env)->GetArrayLength(env, encoded);
-    jbyte *input_bytes = (*env)->GetByteArrayElements(env, encoded, nullptr);
+    VipsImage *image = komelia_from_jvm_handle(env, this);
+    if (image == nullptr)
+        return;
 
-    VipsImage *decoded = vips_image_new_from_buffer(input_bytes, input_len, "", nullptr);
+    const char *path_chars = (*env)->GetStringUTFChars(env, path, nullptr);
+    char *temp_path = g_strdup_printf("%s.v", path_chars);
+    int write_error = vips_vipssave(image, temp_path, nullptr);
+    if (!write_error) {
+        g_remove(path_chars);
+        if (g_rename(temp_path, path_chars) != 0) {
+            vips_error("komelia", "failed to rename %s", temp_path);
+            write_error = -1;
+        }
+    }
+    if (write_error) {
+        g_remove(temp_path);
+    }
+    g_free(temp_path);
+    (*env)->ReleaseStringUTFChars(env, path, path_chars);
 
-    if (!decoded) {
+    if (write_error) {
+        komelia_throw_jvm_vips_exception(env);
+    }
+    vips_thread_shutdown();
+}
+
+// file is mapped into memory, pixels are not decoded or copied.
+// Fails if file was not written by encodeToFileVips
+JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_decodeFromFileVips(
+    JNIEnv *env,
+    jobject this,
+    jstring path
+) {
+    const char *path_chars = (*env)->GetStringUTFChars(env, path, nullptr);
+    VipsImage *decoded = nullptr;
+    int64_t decode_start = komelia_stage_start();
+    int load_error = vips_vipsload(path_chars, &decoded, nullptr);
+    komelia_stage_end(KOMELIA_STAGE_VIPS_DECODE, decode_start);
+    (*env)->ReleaseStringUTFChars(env, path, path_chars);
+
+    if (load_error) {
         komelia_throw_jvm_vips_exception(env);
         vips_thread_shutdown();
         return nullptr;
     }
 
-    jclass jvm_vips_class = (*env)->FindClass(env, "snd/komelia/image/ImageDimensions");
-    jmethodID constructor = (*env)->GetMethodID(env, jvm_vips_class, "<init>", "(III)V");
-    jobject jvm_dimensions = (*env)->NewObject(
+    jobject jvm_handle = komelia_to_jvm_handle(env, decoded, nullptr);
+    if (jvm_handle == nullptr) {
+        g_object_unref(decoded);
+    }
+    vips_thread_shutdown();
+    return jvm_handle;
+}
+
+typedef struct {
+    int width;
+    int height;
+    int bands;
+} HeaderDimensions;
+
+// most formats store dimensions within the first few kilobytes
+#define HEADER_PREFIX_SIZE (64 * 1024)
+
+// loaders only parse header when image is created. Pixels are never decoded here
+static int read_header_dimensions(
+    VipsImage *header,
+    HeaderDimensions *dimensions
+) {
+    if (header == nullptr)
+        return -1;
+
+    dimensions->width = vips_image_get_width(header);
+    dimensions->height = vips_image_get_height(header);
+    dimensions->bands = vips_image_get_bands(header);
+    g_object_unref(header);
+    return 0;
+}
+
+static int read_buffer_dimensions(
+    const void *buffer,
+    size_t buffer_len,
+    HeaderDimensions *dimensions
+) {
+    // probe format first to avoid loader construction for unsupported data
+    if (vips_foreign_find_load_buffer(buffer, buffer_len) == nullptr)
+        return -1;
+    return read_header_dimensions(vips_image_new_from_buffer(buffer, buffer_len, "", nullptr), dimensions);
+}
+
+static jobject to_jvm_dimensions(
+    JNIEnv *env,
+    HeaderDimensions dimensions
+) {
+    jclass jvm_dimensions_class = (*env)->FindClass(env, "snd/komelia/image/ImageDimensions");
+    jmethodID constructor = (*env)->GetMethodID(env, jvm_dimensions_class, "<init>", "(III)V");
+    return (*env)->NewObject(
         env,
-        jvm_vips_class,
+        jvm_dimensions_class,
         constructor,
-        vips_image_get_width(decoded),
-        vips_image_get_height(decoded),
-        vips_image_get_bands(decoded)
+        dimensions.width,
+        dimensions.height,
+        dimensions.bands
     );
-    g_object_unref(decoded);
-    (*env)->ReleaseByteArrayElements(env, encoded, input_bytes, JNI_ABORT);
+}
+
+// copies array prefix instead of pinning the array. Loader construction can be slow and allocate
+// for some formats (heif, pdf, svg) and critical access would block gc for the whole time.
+// Whole array is copied only if header couldn't be parsed from the prefix
+static int read_array_dimensions(
+    JNIEnv *env,
+    jbyteArray encoded,
+    HeaderDimensions *dimensions
+) {
+    jsize input_len = (*env)->GetArrayLength(env, encoded);
+    jsize prefix_len = MIN(input_len, HEADER_PREFIX_SIZE);
+    unsigned char *input_bytes = malloc(prefix_len);
+    (*env)->GetByteArrayRegion(env, encoded, 0, prefix_len, (jbyte *)input_bytes);
+    int read_error = read_buffer_dimensions(input_bytes, prefix_len, dimensions);
+    free(input_bytes);
+
+    if (read_error && prefix_len < input_len) {
+        vips_error_clear();
+        input_bytes = malloc(input_len);
+        (*env)->GetByteArrayRegion(env, encoded, 0, input_len, (jbyte *)input_bytes);
+        read_error = read_buffer_dimensions(input_bytes, input_len, dimensions);
+        free(input_bytes);
+    }
+    return read_error;
+}
+
+JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_getDimensions(
+    JNIEnv *env,
+    jobject this,
+    jbyteArray encoded
+) {
+    HeaderDimensions dimensions = {0};
+    if (read_array_dimensions(env, encoded, &dimensions)) {
+        komelia_throw_jvm_vips_exception(env);
+        vips_thread_shutdown();
+        return nullptr;
+    }
 
     vips_thread_shutdown();
-    return jvm_dimensions;
+    return to_jvm_dimensions(env, dimensions);
+}
+
+static void set_batch_dimensions(
+    jint *result,
+    int index,
+    int read_error,
+    HeaderDimensions dimensions
+) {
+    if (read_error) {
+        // unreadable entries are reported with negative size
+        result[index * 3] = -1;
+        result[index * 3 + 1] = -1;
+        result[index * 3 + 2] = -1;
+        vips_error_clear();
+    } else {
+        result[index * 3] = dimensions.width;
+        result[index * 3 + 1] = dimensions.height;
+        result[index * 3 + 2] = dimensions.bands;
+    }
+}
+
+// returns width, height and bands of each entry packed into a single int array
+JNIEXPORT jintArray JNICALL Java_snd_komelia_image_VipsImage_getDimensionsFromFiles(
+    JNIEnv *env,
+    jobject this,
+    jobjectArray paths
+) {
+    jsize count = (*env)->GetArrayLength(env, paths);
+    jint *result = malloc(sizeof(jint) * 3 * count);
+    char **path_chars = malloc(sizeof(char *) * count);
+    for (int i = 0; i < count; ++i) {
+        jstring path = (*env)->GetObjectArrayElement(env, paths, i);
+        const char *chars = (*env)->GetStringUTFChars(env, path, nullptr);
+        path_chars[i] = g_strdup(chars);
+        (*env)->ReleaseStringUTFChars(env, path, chars);
+        (*env)->DeleteLocalRef(env, path);
+    }
+
+    // header reads are independent, most of the time is spent waiting on file io
+#pragma omp parallel
+    {
+#pragma omp for schedule(dynamic)
+        for (int i = 0; i < count; ++i) {
+            HeaderDimensions dimensions = {0};
+            int read_error = -1;
+            if (vips_foreign_find_load(path_chars[i]) != nullptr) {
+                read_error = read_header_dimensions(vips_image_new_from_file(path_chars[i], nullptr), &dimensions);
+            }
+            set_batch_dimensions(result, i, read_error, dimensions);
+        }
+        vips_thread_shutdown();
+    }
+
+    for (int i = 0; i < count; ++i) {
+        g_free(path_chars[i]);
+    }
+    free(path_chars);
+
+    jintArray jvm_result = (*env)->NewIntArray(env, 3 * count);
+    (*env)->SetIntArrayRegion(env, jvm_result, 0, 3 * count, result);
+    free(result);
+    return jvm_result;
 }
 
 JNIEXPORT jbyteArray JNICALL Java_snd_komelia_image_VipsImage_getBytes(
@@ -267,7 +648,9 @@ JNIEXPORT jbyteArray JNICALL Java_snd_komelia_image_VipsImage_getBytes(
     if (image == nullptr)
         return nullptr;
 
+    int64_t render_start = komelia_stage_start();
     unsigned char *data = (unsigned char *)vips_image_get_data(image);
+    komelia_stage_end(KOMELIA_STAGE_VIPS_RENDER, render_start);
     if (data == nullptr) {
         komelia_throw_jvm_vips_exception(env);
         return nullptr;
@@ -278,13 +661,77 @@ JNIEXPORT jbyteArray JNICALL Java_snd_komelia_image_VipsImage_getBytes(
     int height = vips_image_get_height(image);
     int size = bands * width * height;
 
+    int64_t copy_start = komelia_stage_start();
     jbyteArray java_bytes = (*env)->NewByteArray(env, size);
     (*env)->SetByteArrayRegion(env, java_bytes, 0, size, (signed char *)data);
+    komelia_stage_end(KOMELIA_STAGE_VIPS_BITMAP_COPY, copy_start);
 
     vips_thread_shutdown();
     return java_bytes;
 }
 
+typedef struct {
+    VipsPel *pixels;
+    size_t row_bytes;
+    bool premultiply;
+} PixelsTarget;
+
+static int write_region_rows(
+    VipsRegion *region,
+    VipsRect *area,
+    void *a
+) {
+    PixelsTarget *target = a;
+    int64_t copy_start = komelia_stage_start();
+    size_t pel_size = VIPS_IMAGE_SIZEOF_PEL(region->im);
+    size_t line_size = pel_size * area->width;
+    for (int y = area->top; y < VIPS_RECT_BOTTOM(area); ++y) {
+        VipsPel *line = target->pixels + y * target->row_bytes + area->left * pel_size;
+        if (target->premultiply) {
+            // premultiply while copying, row is still hot in cache
+            komelia_premultiply_rgba(line, VIPS_REGION_ADDR(region, area->left, y), area->width);
+        } else {
+            memcpy(line, VIPS_REGION_ADDR(region, area->left, y), line_size);
+        }
+    }
+    komelia_stage_end(KOMELIA_STAGE_VIPS_BITMAP_COPY, copy_start);
+    return 0;
+}
+
+// renders image straight into externally owned pixel memory (e.g. skia bitmap pixels)
+// without materializing intermediate copy of the whole image.
+// If premultiply is set, 4 band images are written with premultiplied alpha
+JNIEXPORT void JNICALL Java_snd_komelia_image_VipsImage_writeToPixels(
+    JNIEnv *env,
+    jobject this,
+    jlong pixels,
+    jlong row_bytes,
+    jboolean premultiply
+) {
+    VipsImage *image = komelia_from_jvm_handle(env, this);
+    if (image == nullptr)
+        return;
+
+    if (row_bytes < VIPS_IMAGE_SIZEOF_LINE(image)) {
+        komelia_throw_jvm_vips_exception_message(env, "row bytes are smaller than image line size");
+        return;
+    }
+
+    PixelsTarget target = {
+        .pixels = (VipsPel *)pixels,
+        .row_bytes = row_bytes,
+        .premultiply = premultiply && vips_image_get_bands(image) == 4 && !komelia_image_is_opaque(image)
+    };
+    // includes pixel decoding and conversions of lazy pipeline
+    int64_t render_start = komelia_stage_start();
+    int render_error = vips_sink_disc(image, write_region_rows, &target);
+    komelia_stage_end(KOMELIA_STAGE_VIPS_RENDER, render_start);
+    if (render_error) {
+        komelia_throw_jvm_vips_exception(env);
+    }
+    vips_thread_shutdown();
+}
+
 VipsRect to_vips_rect(
     JNIEnv *env,
     jobject jvm_rect
@@ -334,6 +781,34 @@ JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_extractArea(
     return jvm_image;
 }
 
+static VipsKernel to_vips_kernel(
+    JNIEnv *env,
+    jstring jvm_kernel
+) {
+    const char *name_chars = (*env)->GetStringUTFChars(env, jvm_kernel, nullptr);
+    VipsKernel kernel = VIPS_KERNEL_LANCZOS3;
+    if (strcmp(name_chars, "NEAREST") == 0) {
+        kernel = VIPS_KERNEL_NEAREST;
+    } else if (strcmp(name_chars, "LINEAR") == 0) {
+        kernel = VIPS_KERNEL_LINEAR;
+    } else if (strcmp(name_chars, "CUBIC") == 0) {
+        kernel = VIPS_KERNEL_CUBIC;
+    } else if (strcmp(name_chars, "MITCHELL") == 0) {
+        kernel = VIPS_KERNEL_MITCHELL;
+    } else if (strcmp(name_chars, "LANCZOS2") == 0) {
+        kernel = VIPS_KERNEL_LANCZOS2;
+    } else if (strcmp(name_chars, "LANCZOS3") == 0) {
+        kernel = VIPS_KERNEL_LANCZOS3;
+    }
+    // else if (strcmp(name_chars, "MKS2013") == 0) {
+    //   kernel = VIPS_KERNEL_MKS2013;
+    // } else if (strcmp(name_chars, "MKS2021") == 0) {
+    //   kernel = VIPS_KERNEL_MKS2021;
+    // }
+    (*env)->ReleaseStringUTFChars(env, jvm_kernel, name_chars);
+    return kernel;
+}
+
 JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_resize(
     JNIEnv *env,
     jobject this,
@@ -359,28 +834,7 @@ JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_resize(
             nullptr
         );
     } else {
-        const char *name_chars = (*env)->GetStringUTFChars(env, jvm_kernel, nullptr);
-        VipsKernel kernel = VIPS_KERNEL_LANCZOS3;
-        if (strcmp(name_chars, "NEAREST") == 0) {
-            kernel = VIPS_KERNEL_NEAREST;
-        } else if (strcmp(name_chars, "LINEAR") == 0) {
-            kernel = VIPS_KERNEL_LINEAR;
-        } else if (strcmp(name_chars, "CUBIC") == 0) {
-            kernel = VIPS_KERNEL_CUBIC;
-        } else if (strcmp(name_chars, "MITCHELL") == 0) {
-            kernel = VIPS_KERNEL_MITCHELL;
-        } else if (strcmp(name_chars, "LANCZOS2") == 0) {
-            kernel = VIPS_KERNEL_LANCZOS2;
-        } else if (strcmp(name_chars, "LANCZOS3") == 0) {
-            kernel = VIPS_KERNEL_LANCZOS3;
-        }
-        // else if (strcmp(name_chars, "MKS2013") == 0) {
-        //   kernel = VIPS_KERNEL_MKS2013;
-        // } else if (strcmp(name_chars, "MKS2021") == 0) {
-        //   kernel = VIPS_KERNEL_MKS2021;
-        // }
-        (*env)->ReleaseStringUTFChars(env, jvm_kernel, name_chars);
-
+        VipsKernel kernel = to_vips_kernel(env, jvm_kernel);
         vips_thumbnail_image(
             image,
             &resized,
@@ -409,6 +863,157 @@ JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_resize(
     return jvm_image;
 }
 
+static int clamp_scaled(
+    int value,
+    double scale,
+    int max
+) {
+    int scaled = (int)round(value * scale);
+    return scaled > max ? max : scaled;
+}
+
+// Resizes the area covering all requested tiles with a single pipeline and splits the result into tiles.
+// Returned tiles are views over one shared in-memory image
+JNIEXPORT jobjectArray JNICALL Java_snd_komelia_image_VipsImage_extractAndResizeTiles(
+    JNIEnv *env,
+    jobject this,
+    jobjectArray jvm_rects,
+    jdouble scale,
+    jstring jvm_kernel,
+    jboolean linear
+) {
+    VipsImage *image = komelia_from_jvm_handle(env, this);
+    if (image == nullptr)
+        return nullptr;
+
+    jsize tile_count = (*env)->GetArrayLength(env, jvm_rects);
+    jclass jvm_vips_class = (*env)->FindClass(env, "snd/komelia/image/VipsImage");
+    jobjectArray jvm_tiles = (*env)->NewObjectArray(env, tile_count, jvm_vips_class, nullptr);
+    if (tile_count == 0)
+        return jvm_tiles;
+
+    // tile count comes from the jvm, keep rects off the stack
+    VipsRect *tile_rects = g_new(VipsRect, tile_count);
+    VipsRect bounds;
+    for (int i = 0; i < tile_count; ++i) {
+        jobject jvm_rect = (*env)->GetObjectArrayElement(env, jvm_rects, i);
+        tile_rects[i] = to_vips_rect(env, jvm_rect);
+        (*env)->DeleteLocalRef(env, jvm_rect);
+
+        if (i == 0) {
+            bounds = tile_rects[i];
+        } else {
+            vips_rect_unionrect(&bounds, &tile_rects[i], &bounds);
+        }
+    }
+
+    VipsImage *area = nullptr;
+    if (vips_extract_area(image, &area, bounds.left, bounds.top, bounds.width, bounds.height, nullptr)) {
+        komelia_throw_jvm_vips_exception(env);
+        g_free(tile_rects);
+        vips_thread_shutdown();
+        return nullptr;
+    }
+
+    int target_width = (int)round(bounds.width * scale);
+    int target_height = (int)round(bounds.height * scale);
+    if (target_width < 1)
+        target_width = 1;
+    if (target_height < 1)
+        target_height = 1;
+
+    VipsImage *resized = nullptr;
+    if (jvm_kernel == nullptr) {
+        vips_thumbnail_image(
+            area,
+            &resized,
+            target_width,
+            "height",
+            target_height,
+            "size",
+            VIPS_SIZE_FORCE,
+            "linear",
+            linear,
+            nullptr
+        );
+    } else {
+        vips_thumbnail_image(
+            area,
+            &resized,
+            target_width,
+            "height",
+            target_height,
+            "size",
+            VIPS_SIZE_FORCE,
+            "linear",
+            linear,
+            "kernel",
+            to_vips_kernel(env, jvm_kernel),
+            nullptr
+        );
+    }
+    g_object_unref(area);
+    if (resized == nullptr) {
+        komelia_throw_jvm_vips_exception(env);
+        g_free(tile_rects);
+        vips_thread_shutdown();
+        return nullptr;
+    }
+
+    // evaluate whole area once using vips threadpool
+    VipsImage *rendered = vips_image_copy_memory(resized);
+    g_object_unref(resized);
+    if (rendered == nullptr) {
+        komelia_throw_jvm_vips_exception(env);
+        g_free(tile_rects);
+        vips_thread_shutdown();
+        return nullptr;
+    }
+
+    int rendered_width = vips_image_get_width(rendered);
+    int rendered_height = vips_image_get_height(rendered);
+    for (int i = 0; i < tile_count; ++i) {
+        VipsRect *rect = &tile_rects[i];
+        int left = clamp_scaled(rect->left - bounds.left, scale, rendered_width - 1);
+        int top = clamp_scaled(rect->top - bounds.top, scale, rendered_height - 1);
+        int right = clamp_scaled(rect->left - bounds.left + rect->width, scale, rendered_width);
+        int bottom = clamp_scaled(rect->top - bounds.top + rect->height, scale, rendered_height);
+
+        VipsImage *tile = nullptr;
+        if (vips_extract_area(
+                rendered,
+                &tile,
+                left,
+                top,
+                right > left ? right - left : 1,
+                bottom > top ? bottom - top : 1,
+                nullptr
+            )) {
+            komelia_throw_jvm_vips_exception(env);
+            g_object_unref(rendered);
+            g_free(tile_rects);
+            vips_thread_shutdown();
+            return nullptr;
+        }
+
+        jobject jvm_tile = komelia_to_jvm_handle(env, tile, nullptr);
+        if (jvm_tile == nullptr) {
+            g_object_unref(tile);
+            g_object_unref(rendered);
+            g_free(tile_rects);
+            vips_thread_shutdown();
+            return nullptr;
+        }
+        (*env)->SetObjectArrayElement(env, jvm_tiles, i, jvm_tile);
+        (*env)->DeleteLocalRef(env, jvm_tile);
+    }
+
+    g_object_unref(rendered);
+    g_free(tile_rects);
+    vips_thread_shutdown();
+    return jvm_tiles;
+}
+
 JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_shrink(
     JNIEnv *env,
     jobject this,
@@ -0,0 +1,179 @@
+#include "vips_common_jni.h"
+#include "komelia_stage_stats.h"
+
+#define JVM_STREAM_CHUNK_SIZE (64 * 1024)
+
+// vips source that pulls encoded bytes from java.io.InputStream.
+// Loader can parse header and start decoding while the rest of the stream is still arriving.
+// Every image decoded from the source or derived from it holds a reference to the source,
+// stream is closed only after the last of them is released
+typedef struct {
+    JavaVM *jvm;
+    jobject stream;
+    jbyteArray chunk;
+    jmethodID read_method;
+    jmethodID close_method;
+    // vips worker threads can read concurrently, chunk array is shared between reads
+    GMutex lock;
+} JvmStream;
+
+static JNIEnv *get_jvm_env(
+    JavaVM *jvm,
+    bool *attached
+) {
+    JNIEnv *env = nullptr;
+    *attached = false;
+    jint status = (*jvm)->GetEnv(jvm, (void **)&env, JNI_VERSION_1_6);
+    if (status == JNI_OK)
+        return env;
+    if (status != JNI_EDETACHED)
+        return nullptr;
+
+    // reads can happen on vips worker threads that are not known to jvm
+#ifdef __ANDROID__
+    jint attach_error = (*jvm)->AttachCurrentThreadAsDaemon(jvm, &env, nullptr);
+#else
+    jint attach_error = (*jvm)->AttachCurrentThreadAsDaemon(jvm, (void **)&env, nullptr);
+#endif
+    if (attach_error != JNI_OK)
+        return nullptr;
+
+    *attached = true;
+    return env;
+}
+
+static void release_jvm_env(
+    JavaVM *jvm,
+    bool attached
+) {
+    if (attached) {
+        (*jvm)->DetachCurrentThread(jvm);
+    }
+}
+
+static gint64 read_jvm_stream(
+    VipsSourceCustom *source,
+    void *buffer,
+    gint64 length,
+    JvmStream *stream
+) {
+    bool attached;
+    JNIEnv *env = get_jvm_env(stream->jvm, &attached);
+    if (env == nullptr) {
+        vips_error("komelia", "failed to attach thread to jvm");
+        return -1;
+    }
+
+    g_mutex_lock(&stream->lock);
+    jint to_read = (jint)MIN(length, JVM_STREAM_CHUNK_SIZE);
+    int64_t read_start = komelia_stage_start();
+    jint bytes_read =
+        (*env)->CallIntMethod(env, stream->stream, stream->read_method, stream->chunk, 0, to_read);
+    komelia_stage_end(KOMELIA_STAGE_STREAM_READ, read_start);
+
+    gint64 result;
+    if ((*env)->ExceptionCheck(env)) {
+        (*env)->ExceptionClear(env);
+        vips_error("komelia", "failed to read from jvm stream");
+        result = -1;
+    } else if (bytes_read < 0) {
+        // end of stream
+        result = 0;
+    } else {
+        (*env)->GetByteArrayRegion(env, stream->chunk, 0, bytes_read, (jbyte *)buffer);
+        result = bytes_read;
+    }
+    g_mutex_unlock(&stream->lock);
+
+    release_jvm_env(stream->jvm, attached);
+    return result;
+}
+
+// called when the last reference to the source is released.
+// Source is referenced by loader of every image that can still read from the stream
+static void release_jvm_stream(
+    gpointer data,
+    GObject *source
+) {
+    JvmStream *stream = data;
+    bool attached;
+    JNIEnv *env = get_jvm_env(stream->jvm, &attached);
+    if (env != nullptr) {
+        (*env)->CallVoidMethod(env, stream->stream, stream->close_method);
+        if ((*env)->ExceptionCheck(env)) {
+            (*env)->ExceptionClear(env);
+        }
+        (*env)->DeleteGlobalRef(env, stream->stream);
+        (*env)->DeleteGlobalRef(env, stream->chunk);
+    }
+    release_jvm_env(stream->jvm, attached);
+
+    g_mutex_clear(&stream->lock);
+    free(stream);
+}
+
+static VipsSource *new_jvm_stream_source(
+    JNIEnv *env,
+    jobject jvm_stream
+) {
+    jclass stream_class = (*env)->FindClass(env, "java/io/InputStream");
+    jmethodID read_method = (*env)->GetMethodID(env, stream_class, "read", "([BII)I");
+    jmethodID close_method = (*env)->GetMethodID(env, stream_class, "close", "()V");
+    jbyteArray chunk = (*env)->NewByteArray(env, JVM_STREAM_CHUNK_SIZE);
+    if (chunk == nullptr)
+        return nullptr;
+
+    JvmStream *stream = malloc(sizeof(JvmStream));
+    (*env)->GetJavaVM(env, &stream->jvm);
+    stream->stream = (*env)->NewGlobalRef(env, jvm_stream);
+    stream->chunk = (*env)->NewGlobalRef(env, chunk);
+    stream->read_method = read_method;
+    stream->close_method = close_method;
+    g_mutex_init(&stream->lock);
+    (*env)->DeleteLocalRef(env, chunk);
+
+    VipsSourceCustom *source = vips_source_custom_new();
+    g_signal_connect(source, "read", G_CALLBACK(read_jvm_stream), stream);
+    g_object_weak_ref(G_OBJECT(source), release_jvm_stream, stream);
+    return VIPS_SOURCE(source);
+}
+
+// only header is parsed before returning. Pixels are decoded on first access.
+// n_pages is not passed to the loader if it's 0
+JNIEXPORT jobject JNICALL Java_snd_komelia_image_VipsImage_decodeInputStream(
+    JNIEnv *env,
+    jobject this,
+    jobject jvm_stream,
+    jint n_pages
+) {
+    VipsSource *source = new_jvm_stream_source(env, jvm_stream);
+    if (source == nullptr) {
+        komelia_throw_jvm_vips_exception_message(env, "failed to create stream source");
+        return nullptr;
+    }
+
+    VipsImage *decoded;
+    int64_t decode_start = komelia_stage_start();
+    if (n_pages != 0) {
+        decoded = vips_image_new_from_source(source, "", "n", n_pages, nullptr);
+    } else {
+        decoded = vips_image_new_from_source(source, "", nullptr);
+    }
+    komelia_stage_end(KOMELIA_STAGE_VIPS_DECODE, decode_start);
+    // image holds its own reference to the source. Stream is closed here if decode failed
+    g_object_unref(source);
+
+    if (!decoded) {
+        komelia_throw_jvm_vips_exception(env);
+        vips_thread_shutdown();
+        return nullptr;
+    }
+
+    jobject jvm_image = komelia_to_jvm_handle(env, decoded, nullptr);
+    if (jvm_image == nullptr) {
+        g_object_unref(decoded);
+    }
+
+    vips_thread_shutdown();
+    return jvm_image;
+}
@@ -1,4 +1,5 @@
 #include "vips_common_jni.h"
+#include "komelia_stage_stats.h"
 #include <stdint.h>
 
 void komelia_throw_jvm_vips_exception_message(
@@ -79,12 +80,52 @@ int transform_to_supported_format(
             return -1;
         }
 
+        vips_image_set_int(with_alpha, KOMELIA_META_OPAQUE, 1);
         *transformed = with_alpha;
     }
 
     return 0;
 }
 
+bool komelia_image_is_opaque(VipsImage *image) {
+    if (!vips_image_hasalpha(image))
+        return true;
+
+    int opaque = 0;
+    if (vips_image_get_typeof(image, KOMELIA_META_OPAQUE) &&
+        vips_image_get_int(image, KOMELIA_META_OPAQUE, &opaque) == 0) {
+        return opaque;
+    }
+    return false;
+}
+
+// (c * a + 127) / 255 without division. Exact for all 8-bit inputs
+static inline VipsPel mul_div_255(
+    uint32_t c,
+    uint32_t a
+) {
+    uint32_t t = c * a + 128;
+    return (VipsPel)((t + (t >> 8)) >> 8);
+}
+
+void komelia_premultiply_rgba(
+    VipsPel *dst,
+    const VipsPel *src,
+    size_t pixel_count
+) {
+    // simple per pixel loop without branches so that compiler can vectorize it
+#pragma omp simd
+    for (size_t i = 0; i < pixel_count; ++i) {
+        const VipsPel *s = src + i * 4;
+        VipsPel *d = dst + i * 4;
+        uint32_t alpha = s[3];
+        d[0] = mul_div_255(s[0], alpha);
+        d[1] = mul_div_255(s[1], alpha);
+        d[2] = mul_div_255(s[2], alpha);
+        d[3] = (VipsPel)alpha;
+    }
+}
+
 VipsImage *komelia_from_jvm_handle(
     JNIEnv *env,
     jobject jvm_image
@@ -107,7 +148,9 @@ jobject komelia_to_jvm_handle(
     const unsigned char *external_source_buffer
 ) {
     VipsImage *transformed = nullptr;
+    int64_t colourspace_start = komelia_stage_start();
     int transform_error = transform_to_supported_format(env, image, &transformed);
+    komelia_stage_end(KOMELIA_STAGE_VIPS_COLOURSPACE, colourspace_start);
     if (transform_error) {
         return nullptr;
     }
@@ -123,7 +166,7 @@ jobject komelia_to_jvm_handle(
         env,
         jvm_vips_class,
         "<init>",
-        "(IIIIII[ILsnd/komelia/image/ImageFormat;JJ)V"
+        "(IIIIII[ILsnd/komelia/image/ImageFormat;ZJJ)V"
     );
 
     jobject jvm_type_enum = get_jvm_enum_type(env, transformed);
@@ -156,6 +199,7 @@ jobject komelia_to_jvm_handle(
         pages_loaded,
         jvm_delay_array,
         jvm_type_enum,
+        (jboolean)komelia_image_is_opaque(transformed),
         (int64_t)external_source_buffer,
         (int64_t)transformed
     );
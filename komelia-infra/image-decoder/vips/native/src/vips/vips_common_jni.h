@@ -4,6 +4,9 @@
 #include <jni.h>
 #include <vips/vips.h>
 
+// set on images that got alpha channel only to use 32 bits per pixel. Alpha of such images is always opaque
+#define KOMELIA_META_OPAQUE "komelia-opaque"
+
 JNIEXPORT void komelia_throw_jvm_vips_exception_message(
     JNIEnv *env,
     const char *message
@@ -27,4 +30,14 @@ JNIEXPORT jobject komelia_to_jvm_handle(
     const unsigned char *external_source_buffer
 );
 
+// true if image has no alpha channel or its alpha channel is known to be fully opaque
+JNIEXPORT bool komelia_image_is_opaque(VipsImage *image);
+
+// converts 8-bit unpremultiplied RGBA pixels to premultiplied. dst and src may point to the same memory
+JNIEXPORT void komelia_premultiply_rgba(
+    VipsPel *dst,
+    const VipsPel *src,
+    size_t pixel_count
+);
+
 #endif // KOMELIA_VIPS_COMMON_JNI_H
\ No newline at end of file
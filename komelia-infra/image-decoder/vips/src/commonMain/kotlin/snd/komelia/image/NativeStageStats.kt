@@ -0,0 +1,30 @@
+package snd.komelia.image
+
+/**
+ * Process wide wall time of native hot path stages: decoding, colourspace conversion,
+ * rendering into bitmaps, upscaler tile processing and RF-DETR inference.
+ * Stats are accumulated until [reset]
+ */
+object NativeStageStats {
+
+    external fun snapshot(): Array<Stage>
+    external fun reset()
+
+    /**
+     * [histogram] entry i counts durations in [2^i, 2^(i+1)) microseconds
+     */
+    class Stage(
+        val name: String,
+        val count: Long,
+        val totalMicros: Long,
+        val maxMicros: Long,
+        val histogram: LongArray,
+    ) {
+        val averageMicros: Long
+            get() = if (count == 0L) 0 else totalMicros / count
+
+        override fun toString(): String {
+            return "$name: count=$count total=${totalMicros / 1000}ms avg=${averageMicros}us max=${maxMicros}us"
+        }
+    }
+}
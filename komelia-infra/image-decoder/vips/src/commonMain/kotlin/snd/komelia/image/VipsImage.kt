@@ -2,6 +2,7 @@ package snd.komelia.image
 
 import snd.jni.Managed
 import snd.jni.NativePointer
+import java.io.InputStream
 
 class VipsImage private constructor(
     val width: Int,
@@ -12,6 +13,8 @@ class VipsImage private constructor(
     val pagesLoaded: Int,
     val pageDelays: IntArray?,
     val type: ImageFormat,
+    /** true if image has no alpha channel or alpha channel was added only for 32 bit pixel layout */
+    val isOpaque: Boolean,
     internalBuffer: NativePointer,
     vipsPointer: NativePointer,
 ) : Managed(vipsPointer, VipsFinalizer(internalBuffer, vipsPointer)) {
@@ -26,9 +29,29 @@ class VipsImage private constructor(
     companion object {
         const val DIMENSION_MAX_SIZE = 10_000_000
 
+        /**
+         * Parses only image header. Pixels are not decoded
+         */
         @JvmStatic
         external fun getDimensions(encoded: ByteArray): ImageDimensions
 
+        /**
+         * Reads image headers of multiple files in parallel.
+         * Returns null for entries that couldn't be parsed
+         */
+        fun getDimensionsFromFiles(paths: List<String>): List<ImageDimensions?> {
+            return getDimensionsFromFiles(paths.toTypedArray()).toDimensionsList()
+        }
+
+        // width, height and bands of each image packed one after another
+        private fun IntArray.toDimensionsList(): List<ImageDimensions?> {
+            return (0 until size / 3).map { i ->
+                val width = this[i * 3]
+                if (width < 0) null
+                else ImageDimensions(width = width, height = this[i * 3 + 1], bands = this[i * 3 + 2])
+            }
+        }
+
         @JvmStatic
         external fun decode(encoded: ByteArray, nPages: Int? = null): VipsImage
 
@@ -36,6 +59,32 @@ class VipsImage private constructor(
         @JvmStatic
         external fun decodeFromFile(path: String, nPages: Int? = null): VipsImage
 
+        /**
+         * Decodes image while encoded bytes are read from [stream].
+         * Only image header is parsed before returning, the rest of the stream is read on vips worker threads
+         * when pixels are accessed. Stream is closed after this image and all images derived from it are released
+         */
+        fun decodeFromStream(stream: InputStream, nPages: Int? = null): VipsImage {
+            return decodeInputStream(stream, nPages ?: 0)
+        }
+
+        /**
+         * Loads file written by [encodeToFileVips]. File is mapped into memory without decoding
+         */
+        @JvmStatic
+        external fun decodeFromFileVips(path: String): VipsImage
+
+        /**
+         * Decodes image at the lowest resolution that still covers [targetWidth] x [targetHeight].
+         * Uses jpeg and webp shrink-on-load, other formats are decoded at full resolution.
+         * Size before shrinking is available through [getOriginalDimensions]
+         */
+        @JvmStatic
+        external fun decodeForDisplay(encoded: ByteArray, targetWidth: Int, targetHeight: Int): VipsImage
+
+        @JvmStatic
+        external fun decodeFromFileForDisplay(path: String, targetWidth: Int, targetHeight: Int): VipsImage
+
         @JvmStatic
         external fun thumbnail(
             path: String,
@@ -52,9 +101,38 @@ class VipsImage private constructor(
             crop: Boolean
         ): VipsImage
 
+        /**
+         * Creates thumbnails for all [paths] on a shared native worker pool.
+         * [callback] is invoked on the calling thread in completion order. Call blocks until all thumbnails are delivered.
+         * Throwing from [callback] cancels thumbnails that weren't started yet
+         */
+        @JvmStatic
+        external fun thumbnailBatch(
+            paths: Array<String>,
+            scaleWidth: Int,
+            scaleHeight: Int,
+            crop: Boolean,
+            callback: ThumbnailCallback
+        )
+
+        @JvmStatic
+        external fun thumbnailBufferBatch(
+            encoded: Array<ByteArray>,
+            scaleWidth: Int,
+            scaleHeight: Int,
+            crop: Boolean,
+            callback: ThumbnailCallback
+        )
+
         @JvmStatic
         external fun vipsInit()
 
+        @JvmStatic
+        private external fun getDimensionsFromFiles(paths: Array<String>): IntArray
+
+        @JvmStatic
+        private external fun decodeInputStream(stream: InputStream, nPages: Int): VipsImage
+
         @JvmStatic
         private external fun gObjectUnref(pointer: NativePointer)
 
@@ -65,9 +143,34 @@ class VipsImage private constructor(
     external fun extractArea(rect: ImageRect): VipsImage
     external fun resize(targetWidth: Int, targetHeight: Int, kernel: String?, linear: Boolean): VipsImage
 
+    /**
+     * Extracts and downscales multiple tiles in a single native call.
+     * Area covering all [tiles] is resized once and split into tiles that share the same memory
+     */
+    external fun extractAndResizeTiles(
+        tiles: Array<ImageRect>,
+        scaleFactor: Double,
+        kernel: String?,
+        linear: Boolean
+    ): Array<VipsImage>
+
     external fun getBytes(): ByteArray
+    external fun getOriginalDimensions(): ImageDimensions
+
+    /**
+     * Renders image directly into native pixel memory at [pixels] address.
+     * Memory must be at least [rowBytes] * [height] bytes long.
+     * With [premultiply] set, color channels of non-opaque RGBA images are multiplied by alpha while writing
+     */
+    external fun writeToPixels(pixels: NativePointer, rowBytes: Long, premultiply: Boolean)
     external fun encodeToFile(path: String)
     external fun encodeToFilePng(path: String)
+
+    /**
+     * Writes uncompressed image with all metadata in vips native format.
+     * Much faster to write and load than compressed formats at the cost of file size
+     */
+    external fun encodeToFileVips(path: String)
     external fun shrink(factor: Double): VipsImage
     external fun findTrim(): ImageRect
 
@@ -75,6 +178,11 @@ class VipsImage private constructor(
     external fun mapLookupTable(table: ByteArray): VipsImage
 }
 
+fun interface ThumbnailCallback {
+    // either image or error is null
+    fun onThumbnail(index: Int, image: VipsImage?, error: String?)
+}
+
 class VipsException : RuntimeException {
     constructor() : super()
     constructor(message: String) : super(message)
@@ -0,0 +1,29 @@
+package snd.komelia.image
+
+/**
+ * Process wide native cache of decoded images. Entries are stored as in-memory copies
+ * and evicted in least recently used order once cache size exceeds [setMaxSize] limit
+ */
+object VipsImageCache {
+
+    external fun get(key: String): VipsImage?
+
+    /**
+     * Decodes [image] into memory and stores it in cache.
+     * Images larger than a quarter of cache size are not stored
+     */
+    external fun put(key: String, image: VipsImage)
+    external fun remove(key: String)
+    external fun clear()
+    external fun setMaxSize(maxSizeBytes: Long)
+    external fun getStats(): Stats
+
+    data class Stats(
+        val hits: Long,
+        val misses: Long,
+        val evictions: Long,
+        val entries: Long,
+        val sizeBytes: Long,
+        val maxSizeBytes: Long,
+    )
+}
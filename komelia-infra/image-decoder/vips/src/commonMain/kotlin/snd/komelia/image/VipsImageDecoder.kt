@@ -2,8 +2,14 @@ package snd.komelia.image
 
 import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.withContext
+import kotlinx.io.RawSource
+import kotlinx.io.asInputStream
+import kotlinx.io.buffered
 
 class VipsImageDecoder : KomeliaImageDecoder {
+    // thumbnails requested concurrently (e.g. by library grid) are created together on native worker pool
+    private val thumbnailBatcher = VipsThumbnailBatcher()
+
     override suspend fun decode(encoded: ByteArray, nPages: Int?): KomeliaImage {
         return withContext(Dispatchers.Default) {
             VipsBackedImage(
@@ -26,6 +32,44 @@ class VipsImageDecoder : KomeliaImageDecoder {
         }
     }
 
+    override suspend fun getDimensionsFromFiles(paths: List<String>): List<ImageDimensions?> {
+        return withContext(Dispatchers.IO) { VipsImage.getDimensionsFromFiles(paths) }
+    }
+
+    override val supportsStreamDecode = true
+
+    // header is read from the source before returning, pixels are decoded as the rest of the source arrives
+    override suspend fun decodeFromStream(source: RawSource, nPages: Int?): KomeliaImage {
+        return withContext(Dispatchers.IO) {
+            VipsBackedImage(VipsImage.decodeFromStream(source.buffered().asInputStream(), nPages))
+        }
+    }
+
+    override suspend fun decodeForDisplay(
+        encoded: ByteArray,
+        targetWidth: Int,
+        targetHeight: Int
+    ): DisplayImage {
+        return withContext(Dispatchers.Default) {
+            VipsImage.decodeForDisplay(encoded, targetWidth, targetHeight).toDisplayImage()
+        }
+    }
+
+    override suspend fun decodeFromFileForDisplay(
+        path: String,
+        targetWidth: Int,
+        targetHeight: Int
+    ): DisplayImage {
+        return withContext(Dispatchers.Default) {
+            VipsImage.decodeFromFileForDisplay(path, targetWidth, targetHeight).toDisplayImage()
+        }
+    }
+
+    private fun VipsImage.toDisplayImage(): DisplayImage {
+        val original = getOriginalDimensions()
+        return DisplayImage(VipsBackedImage(this), original.width, original.height)
+    }
+
     override suspend fun decodeAndResize(
         path: String,
         scaleWidth: Int,
@@ -33,16 +77,14 @@ class VipsImageDecoder : KomeliaImageDecoder {
         crop: Boolean,
         nPages: Int?
     ): KomeliaImage {
-        return withContext(Dispatchers.Default) {
-            VipsBackedImage(
-                VipsImage.thumbnail(
-                    path = path,
-                    scaleWidth = scaleWidth.coerceAtMost(VipsImage.DIMENSION_MAX_SIZE),
-                    scaleHeight = scaleHeight.coerceAtMost(VipsImage.DIMENSION_MAX_SIZE),
-                    crop = crop
-                )
+        return VipsBackedImage(
+            thumbnailBatcher.thumbnail(
+                path = path,
+                scaleWidth = scaleWidth.coerceAtMost(VipsImage.DIMENSION_MAX_SIZE),
+                scaleHeight = scaleHeight.coerceAtMost(VipsImage.DIMENSION_MAX_SIZE),
+                crop = crop
             )
-        }
+        )
     }
 
     override suspend fun decodeAndResize(
@@ -52,16 +94,14 @@ class VipsImageDecoder : KomeliaImageDecoder {
         crop: Boolean,
         nPages: Int?
     ): KomeliaImage {
-        return withContext(Dispatchers.Default) {
-            VipsBackedImage(
-                VipsImage.thumbnailBuffer(
-                    encoded = encoded,
-                    scaleWidth = scaleWidth.coerceAtMost(VipsImage.DIMENSION_MAX_SIZE),
-                    scaleHeight = scaleHeight.coerceAtMost(VipsImage.DIMENSION_MAX_SIZE),
-                    crop = crop
-                )
+        return VipsBackedImage(
+            thumbnailBatcher.thumbnail(
+                encoded = encoded,
+                scaleWidth = scaleWidth.coerceAtMost(VipsImage.DIMENSION_MAX_SIZE),
+                scaleHeight = scaleHeight.coerceAtMost(VipsImage.DIMENSION_MAX_SIZE),
+                crop = crop
             )
-        }
+        )
     }
 }
 
@@ -95,30 +135,48 @@ class VipsBackedImage(val vipsImage: VipsImage) : KomeliaImage {
         kernel: ReduceKernel,
     ): KomeliaImage {
         return withContext(Dispatchers.Default) {
-            val vipsKernel = if (!vipsThumbnailKernelIsSupported) null
-            else when (kernel) {
-                ReduceKernel.DEFAULT -> VipsKernel.LANCZOS3
-                ReduceKernel.NEAREST -> VipsKernel.NEAREST
-                ReduceKernel.LINEAR -> VipsKernel.LINEAR
-                ReduceKernel.CUBIC -> VipsKernel.CUBIC
-                ReduceKernel.MITCHELL -> VipsKernel.MITCHELL
-                ReduceKernel.LANCZOS2 -> VipsKernel.LANCZOS2
-                ReduceKernel.LANCZOS3 -> VipsKernel.LANCZOS3
-                ReduceKernel.MKS2013 -> VipsKernel.MKS2013
-                ReduceKernel.MKS2021 -> VipsKernel.MKS2021
-            }
-
             VipsBackedImage(
                 vipsImage.resize(
                     targetWidth = scaleWidth.coerceAtMost(VipsImage.DIMENSION_MAX_SIZE),
                     targetHeight = scaleHeight.coerceAtMost(VipsImage.DIMENSION_MAX_SIZE),
-                    kernel = vipsKernel?.name,
+                    kernel = kernel.toVipsKernel()?.name,
                     linear = linear,
                 )
             )
         }
     }
 
+    suspend fun extractAndResizeTiles(
+        tiles: List<ImageRect>,
+        scaleFactor: Double,
+        linear: Boolean = false,
+        kernel: ReduceKernel = ReduceKernel.DEFAULT
+    ): List<KomeliaImage> {
+        return withContext(Dispatchers.Default) {
+            vipsImage.extractAndResizeTiles(
+                tiles = tiles.toTypedArray(),
+                scaleFactor = scaleFactor,
+                kernel = kernel.toVipsKernel()?.name,
+                linear = linear
+            ).map { VipsBackedImage(it) }
+        }
+    }
+
+    private fun ReduceKernel.toVipsKernel(): VipsKernel? {
+        if (!vipsThumbnailKernelIsSupported) return null
+        return when (this) {
+            ReduceKernel.DEFAULT -> VipsKernel.LANCZOS3
+            ReduceKernel.NEAREST -> VipsKernel.NEAREST
+            ReduceKernel.LINEAR -> VipsKernel.LINEAR
+            ReduceKernel.CUBIC -> VipsKernel.CUBIC
+            ReduceKernel.MITCHELL -> VipsKernel.MITCHELL
+            ReduceKernel.LANCZOS2 -> VipsKernel.LANCZOS2
+            ReduceKernel.LANCZOS3 -> VipsKernel.LANCZOS3
+            ReduceKernel.MKS2013 -> VipsKernel.MKS2013
+            ReduceKernel.MKS2021 -> VipsKernel.MKS2021
+        }
+    }
+
     override suspend fun getBytes(): ByteArray {
         return vipsImage.getBytes()
     }
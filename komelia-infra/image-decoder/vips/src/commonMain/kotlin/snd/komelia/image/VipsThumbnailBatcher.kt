@@ -0,0 +1,109 @@
+package snd.komelia.image
+
+import kotlinx.coroutines.CompletableDeferred
+import kotlinx.coroutines.CoroutineScope
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.SupervisorJob
+import kotlinx.coroutines.channels.Channel
+import kotlinx.coroutines.delay
+import kotlinx.coroutines.launch
+import kotlin.coroutines.cancellation.CancellationException
+
+// grid items that become visible in the same layout pass request thumbnails within a few milliseconds
+private const val batchWindowMillis = 10L
+
+/**
+ * Collects thumbnail requests that arrive at the same time and creates them in a single native batch
+ * on the shared worker pool instead of one JNI call per thumbnail
+ */
+internal class VipsThumbnailBatcher {
+    private val scope = CoroutineScope(Dispatchers.IO + SupervisorJob())
+    private val requests = Channel<Request>(Channel.UNLIMITED)
+
+    private class Request(
+        val path: String?,
+        val encoded: ByteArray?,
+        val scaleWidth: Int,
+        val scaleHeight: Int,
+        val crop: Boolean,
+    ) {
+        val result = CompletableDeferred<VipsImage>()
+    }
+
+    private data class BatchKey(
+        val isFileBatch: Boolean,
+        val scaleWidth: Int,
+        val scaleHeight: Int,
+        val crop: Boolean,
+    )
+
+    init {
+        scope.launch {
+            for (request in requests) {
+                delay(batchWindowMillis)
+                val pending = mutableListOf(request)
+                while (true) {
+                    pending += requests.tryReceive().getOrNull() ?: break
+                }
+
+                pending.filter { !it.result.isCancelled }
+                    .groupBy { BatchKey(it.path != null, it.scaleWidth, it.scaleHeight, it.crop) }
+                    .forEach { (key, batch) -> launch { runBatch(key, batch) } }
+            }
+        }
+    }
+
+    suspend fun thumbnail(path: String, scaleWidth: Int, scaleHeight: Int, crop: Boolean): VipsImage {
+        return submit(Request(path, null, scaleWidth, scaleHeight, crop))
+    }
+
+    suspend fun thumbnail(encoded: ByteArray, scaleWidth: Int, scaleHeight: Int, crop: Boolean): VipsImage {
+        return submit(Request(null, encoded, scaleWidth, scaleHeight, crop))
+    }
+
+    private suspend fun submit(request: Request): VipsImage {
+        requests.send(request)
+        try {
+            return request.result.await()
+        } catch (e: CancellationException) {
+            // thumbnail is closed on delivery if it's no longer needed
+            request.result.cancel()
+            throw e
+        }
+    }
+
+    private fun runBatch(key: BatchKey, batch: List<Request>) {
+        val callback = ThumbnailCallback { index, image, error ->
+            val request = batch[index]
+            when {
+                image == null -> request.result.completeExceptionally(
+                    VipsException(error ?: "Failed to create thumbnail")
+                )
+
+                !request.result.complete(image) -> image.close()
+            }
+        }
+
+        try {
+            if (key.isFileBatch) {
+                VipsImage.thumbnailBatch(
+                    paths = batch.map { requireNotNull(it.path) }.toTypedArray(),
+                    scaleWidth = key.scaleWidth,
+                    scaleHeight = key.scaleHeight,
+                    crop = key.crop,
+                    callback = callback
+                )
+            } else {
+                VipsImage.thumbnailBufferBatch(
+                    encoded = batch.map { requireNotNull(it.encoded) }.toTypedArray(),
+                    scaleWidth = key.scaleWidth,
+                    scaleHeight = key.scaleHeight,
+                    crop = key.crop,
+                    callback = callback
+                )
+            }
+        } catch (e: Throwable) {
+            batch.forEach { it.result.completeExceptionally(e) }
+        }
+    }
+}
@@ -0,0 +1,55 @@
+package snd.komelia.image
+
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.withContext
+import snd.jni.Managed
+import snd.jni.NativePointer
+
+/**
+ * Persistent store of decoded thumbnails in [directory].
+ * Thumbnails are stored as raw pixels and returned without any decoding step.
+ * Index of all stored thumbnails is loaded into memory when store is opened
+ */
+class VipsThumbnailStore private constructor(
+    val directory: String,
+    ptr: NativePointer,
+) : Managed(ptr, Finalizer(ptr)) {
+
+    /**
+     * Returns null if there's no thumbnail stored for the [key]
+     */
+    external fun get(key: String): VipsImage?
+
+    /**
+     * Replaces existing thumbnail with the same [key]
+     */
+    external fun put(key: String, image: VipsImage)
+    external fun remove(key: String)
+
+    companion object {
+        fun open(directory: String): VipsThumbnailStore {
+            return VipsThumbnailStore(directory, openStore(directory))
+        }
+
+        @JvmStatic
+        private external fun openStore(directory: String): NativePointer
+
+        @JvmStatic
+        private external fun destroy(ptr: NativePointer)
+    }
+
+    private class Finalizer(private var ptr: Long) : Runnable {
+        override fun run() = destroy(ptr)
+    }
+}
+
+class VipsBackedThumbnailStore(private val store: VipsThumbnailStore) : KomeliaThumbnailStore {
+
+    override suspend fun get(key: String): KomeliaImage? {
+        return withContext(Dispatchers.IO) { store.get(key)?.let { VipsBackedImage(it) } }
+    }
+
+    override suspend fun put(key: String, image: KomeliaImage) {
+        withContext(Dispatchers.IO) { store.put(key, image.toVipsImage()) }
+    }
+}
@@ -21,17 +21,20 @@ object SkiaBitmap {
     fun KomeliaImage.toSkiaBitmap(): Bitmap = this.toVipsImage().toSkiaBitmap()
     fun VipsImage.toSkiaBitmap(): Bitmap {
         val colorInfo = when (this.type) {
+            // gray pixels have no alpha, skia treats them as opaque
             GRAYSCALE_8 -> ColorInfo(
                 ColorType.GRAY_8,
-                ColorAlphaType.UNPREMUL,
+                ColorAlphaType.OPAQUE,
                 ColorSpace.sRGB
             )
 
-            RGBA_8888 -> ColorInfo(
-                ColorType.RGBA_8888,
-                ColorAlphaType.UNPREMUL,
-                ColorSpace.sRGB
-            )
+            RGBA_8888 -> if (isOpaque) {
+                // 4th byte is padding, skia can skip blending entirely
+                ColorInfo(ColorType.RGB_888X, ColorAlphaType.OPAQUE, ColorSpace.sRGB)
+            } else {
+                // premultiplied during write so that skia doesn't convert pixels on every draw
+                ColorInfo(ColorType.RGBA_8888, ColorAlphaType.PREMUL, ColorSpace.sRGB)
+            }
 
             HISTOGRAM -> error("Unsupported image format")
         }
@@ -40,10 +43,24 @@ object SkiaBitmap {
         val bitmap = Bitmap()
         bitmap.allocPixels(imageInfo)
 
-        // copy vips image bytes to jvm
-        val bytes = this.getBytes()
-        // copy jvm bytes to skia bitmap
-        bitmap.installPixels(bytes)
+        // render vips image straight into skia owned pixel memory
+        val pixmap = bitmap.peekPixels()
+        if (pixmap == null) {
+            bitmap.close()
+            error("Failed to access bitmap pixels")
+        }
+        try {
+            this.writeToPixels(
+                pixels = pixmap.addr,
+                rowBytes = pixmap.rowBytes.toLong(),
+                premultiply = colorInfo.alphaType == ColorAlphaType.PREMUL
+            )
+        } catch (e: Throwable) {
+            bitmap.close()
+            throw e
+        } finally {
+            pixmap.close()
+        }
         bitmap.setImmutable()
         return bitmap
     }
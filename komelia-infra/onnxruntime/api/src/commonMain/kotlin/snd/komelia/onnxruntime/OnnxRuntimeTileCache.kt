@@ -0,0 +1,7 @@
+package snd.komelia.onnxruntime
+
+/**
+ * Upscaled tiles of a single page. Filled by [OnnxRuntimeUpscaler.upscaleRegion]
+ * and reused by following region upscales of the same page
+ */
+interface OnnxRuntimeTileCache : AutoCloseable
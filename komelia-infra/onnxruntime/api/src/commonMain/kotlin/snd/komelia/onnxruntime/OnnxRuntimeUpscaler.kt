@@ -1,12 +1,34 @@
 package snd.komelia.onnxruntime
 
+import snd.komelia.image.ImageRect
 import snd.komelia.image.KomeliaImage
 
 interface OnnxRuntimeUpscaler {
     fun setExecutionProvider(provider: OnnxRuntimeExecutionProvider, deviceId: Int)
     fun setModelPath(modelPath: String)
     fun setTileSize(tileSize: Int)
+
+    /**
+     * Creates session for [modelPath] in background with current execution provider and tile size.
+     * Following switch to this model doesn't wait for session creation
+     */
+    fun warmUp(modelPath: String)
     fun closeCurrentSession()
     fun getAvailableDevices(): List<DeviceInfo>
     fun upscale(image: KomeliaImage): KomeliaImage
+
+    /**
+     * Writes upscaled image to [path] in vips format, [path] must have .v suffix.
+     * Tiled output is streamed to the file without keeping the whole image in memory
+     */
+    fun upscaleToFile(image: KomeliaImage, path: String)
+
+    fun createTileCache(): OnnxRuntimeTileCache
+
+    /**
+     * Upscales only tiles covering [region] that are missing from [tileCache].
+     * Returned image contains upscaled [region] area.
+     * [tileCache] must only be used with images of the same page
+     */
+    fun upscaleRegion(image: KomeliaImage, region: ImageRect, tileCache: OnnxRuntimeTileCache): KomeliaImage
 }
\ No newline at end of file
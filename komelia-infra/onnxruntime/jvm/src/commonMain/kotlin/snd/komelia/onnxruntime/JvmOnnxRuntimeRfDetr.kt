@@ -17,6 +17,13 @@ class JvmOnnxRuntimeRfDetr private constructor(
 
     private external fun setExecutionProvider(nativeEnumOrdinal: Int, deviceId: Int)
     external override fun setModelPath(modelPath: String)
+
+    /**
+     * Thread count used by the next created session. 0 lets onnxruntime decide.
+     * Inter op threads are only used when set to more than 1
+     */
+    external fun setThreadCount(intraOpThreads: Int, interOpThreads: Int)
+
     external override fun closeCurrentSession()
     override fun getAvailableDevices() = onnxRuntime.enumerateDevices()
 
@@ -0,0 +1,25 @@
+package snd.komelia.onnxruntime
+
+import snd.jni.Managed
+import snd.jni.NativePointer
+
+class JvmOnnxRuntimeTileCache private constructor(
+    internal val ptr: NativePointer
+) : Managed(ptr, Finalizer(ptr)), OnnxRuntimeTileCache {
+
+    companion object {
+        fun create(): JvmOnnxRuntimeTileCache {
+            return JvmOnnxRuntimeTileCache(create())
+        }
+
+        @JvmStatic
+        private external fun create(): NativePointer
+
+        @JvmStatic
+        private external fun destroy(ptr: NativePointer)
+    }
+
+    private class Finalizer(private var ptr: Long) : Runnable {
+        override fun run() = destroy(ptr)
+    }
+}
@@ -2,6 +2,7 @@ package snd.komelia.onnxruntime
 
 import snd.jni.Managed
 import snd.jni.NativePointer
+import snd.komelia.image.ImageRect
 import snd.komelia.image.KomeliaImage
 import snd.komelia.image.VipsBackedImage
 import snd.komelia.image.VipsImage
@@ -17,7 +18,40 @@ class JvmOnnxRuntimeUpscaler private constructor(
 
     private external fun setExecutionProvider(nativeEnumOrdinal: Int, deviceId: Int)
     external override fun setModelPath(modelPath: String)
+
+    /**
+     * Thread count used by the next created session. 0 lets onnxruntime decide.
+     * Inter op threads are only used when set to more than 1
+     */
+    external fun setThreadCount(intraOpThreads: Int, interOpThreads: Int)
+
     external override fun setTileSize(tileSize: Int)
+
+    /**
+     * Number of pixels on each tile side shared with neighbouring tiles.
+     * Overlapped area is discarded from tile output to avoid seams between tiles
+     */
+    external fun setTileOverlap(overlap: Int)
+
+    /**
+     * Max number of tiles inferred in a single run. Only used if model has dynamic batch dimension.
+     * [memoryLimit] is an approximate limit in bytes for batch input and output tensors
+     */
+    external fun setBatchSize(maxBatchSize: Int, memoryLimit: Long)
+
+    /**
+     * Tiled upscale output is written to a temporary file one tile row at a time instead of memory.
+     * Returned image reads pixels from that file on demand, file is deleted when image is closed
+     */
+    external fun setDiskOutput(enabled: Boolean)
+
+    /**
+     * Sessions of previously used models are kept open to make switching between models cheap.
+     * Least recently used sessions are closed when there are more than [maxSessions]
+     * or when estimated size of all sessions exceeds [memoryLimit] bytes
+     */
+    external fun setSessionCacheLimits(maxSessions: Int, memoryLimit: Long)
+    external override fun warmUp(modelPath: String)
     external override fun closeCurrentSession()
     override fun getAvailableDevices() = onnxRuntime.enumerateDevices()
 
@@ -28,6 +62,39 @@ class JvmOnnxRuntimeUpscaler private constructor(
 
     external fun upscale(image: VipsImage): VipsImage
 
+    override fun upscaleToFile(image: KomeliaImage, path: String) {
+        upscaleToFile(image.toVipsImage(), path)
+    }
+
+    external fun upscaleToFile(image: VipsImage, path: String)
+
+    override fun createTileCache(): OnnxRuntimeTileCache = JvmOnnxRuntimeTileCache.create()
+
+    override fun upscaleRegion(
+        image: KomeliaImage,
+        region: ImageRect,
+        tileCache: OnnxRuntimeTileCache
+    ): KomeliaImage {
+        val upscaled = upscaleRegion(
+            image.toVipsImage(),
+            region.left,
+            region.top,
+            region.right,
+            region.bottom,
+            (tileCache as JvmOnnxRuntimeTileCache).ptr
+        )
+        return VipsBackedImage(upscaled)
+    }
+
+    private external fun upscaleRegion(
+        image: VipsImage,
+        left: Int,
+        top: Int,
+        right: Int,
+        bottom: Int,
+        tileCachePtr: NativePointer
+    ): VipsImage
+
     companion object {
         fun create(ort: JvmOnnxRuntime): JvmOnnxRuntimeUpscaler {
             val ptr = create(ort.ptr)
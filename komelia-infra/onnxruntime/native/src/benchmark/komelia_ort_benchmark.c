@@ -0,0 +1,285 @@
+// Headless benchmark of upscaler and RF-DETR inference on cpu provider.
+// Reports per stage timings, throughput and memory usage as json to stdout
+#include "../onnxruntime/komelia_ort_rf_detr.h"
+#include "../onnxruntime/komelia_ort_upscaler.h"
+#include "komelia_stage_stats.h"
+
+#include <stdio.h>
+#include <sys/resource.h>
+
+static char *upscaler_model = nullptr;
+static char *rf_detr_model = nullptr;
+static char **input_files = nullptr;
+static char *data_dir = nullptr;
+static int page_count = 8;
+static int page_width = 1400;
+static int page_height = 2000;
+static int tile_size = 512;
+static int intra_op_threads = 0;
+
+static GOptionEntry option_entries[] = {
+    {"upscaler-model", 'u', 0, G_OPTION_ARG_FILENAME, &upscaler_model, "Upscaler onnx model", "PATH"},
+    {"rf-detr-model", 'r', 0, G_OPTION_ARG_FILENAME, &rf_detr_model, "RF-DETR onnx model", "PATH"},
+    {"input", 'i', 0, G_OPTION_ARG_FILENAME_ARRAY, &input_files, "Sample page. Synthetic pages are used if not set", "PATH"},
+    {"data-dir", 'd', 0, G_OPTION_ARG_FILENAME, &data_dir, "Directory for optimized model cache", "PATH"},
+    {"pages", 'n', 0, G_OPTION_ARG_INT, &page_count, "Number of processed pages", "N"},
+    {"width", 0, 0, G_OPTION_ARG_INT, &page_width, "Synthetic page width", "PIXELS"},
+    {"height", 0, 0, G_OPTION_ARG_INT, &page_height, "Synthetic page height", "PIXELS"},
+    {"tile-size", 't', 0, G_OPTION_ARG_INT, &tile_size, "Upscaler tile size. 0 disables tiling", "PIXELS"},
+    {"threads", 0, 0, G_OPTION_ARG_INT, &intra_op_threads, "Intra op thread count. 0 lets onnxruntime decide", "N"},
+    G_OPTION_ENTRY_NULL
+};
+
+// grayscale noise converted to srgb, same as most manga pages after decoding
+static VipsImage *create_synthetic_page(int seed) {
+    VipsImage *noise = nullptr;
+    VipsImage *page = nullptr;
+    VipsImage *srgb = nullptr;
+    if (vips_gaussnoise(&noise, page_width, page_height, "mean", 160.0, "sigma", 60.0, "seed", seed, nullptr))
+        return nullptr;
+    if (vips_cast_uchar(noise, &page, nullptr)) {
+        g_object_unref(noise);
+        return nullptr;
+    }
+    g_object_unref(noise);
+
+    int error = vips_colourspace(page, &srgb, VIPS_INTERPRETATION_sRGB, "source_space", VIPS_INTERPRETATION_B_W, nullptr);
+    g_object_unref(page);
+    if (error)
+        return nullptr;
+
+    VipsImage *decoded = vips_image_copy_memory(srgb);
+    g_object_unref(srgb);
+    return decoded;
+}
+
+static VipsImage *load_page(const char *path) {
+    VipsImage *image = vips_image_new_from_file(path, nullptr);
+    if (image == nullptr)
+        return nullptr;
+
+    VipsImage *decoded = vips_image_copy_memory(image);
+    g_object_unref(image);
+    return decoded;
+}
+
+// pages are decoded before measurement to exclude decoding from inference timings
+static VipsImage **load_pages(int *count) {
+    int input_count = input_files != nullptr ? (int)g_strv_length(input_files) : 0;
+    *count = input_count > 0 ? input_count : page_count;
+    VipsImage **pages = calloc(*count, sizeof(VipsImage *));
+    for (int i = 0; i < *count; ++i) {
+        pages[i] = input_count > 0 ? load_page(input_files[i]) : create_synthetic_page(i);
+        if (pages[i] == nullptr) {
+            fprintf(stderr, "failed to load page %d: %s\n", i, vips_error_buffer());
+            for (int j = 0; j < i; ++j) {
+                g_object_unref(pages[j]);
+            }
+            free(pages);
+            return nullptr;
+        }
+    }
+    return pages;
+}
+
+static void print_stages(
+    const KomeliaStageStats *stats,
+    KomeliaStage first_stage,
+    KomeliaStage last_stage
+) {
+    printf("    \"stages\": {\n");
+    for (int stage = first_stage; stage <= last_stage; ++stage) {
+        printf(
+            "      \"%s\": {\"count\": %llu, \"total_ms\": %.3f, \"max_ms\": %.3f, \"histogram_log2_us\": [",
+            komelia_stage_name(stage),
+            (unsigned long long)stats[stage].count,
+            (double)stats[stage].total_us / 1000.0,
+            (double)stats[stage].max_us / 1000.0
+        );
+        for (int i = 0; i < KOMELIA_STAGE_HISTOGRAM_BUCKETS; ++i) {
+            printf("%s%llu", i == 0 ? "" : ", ", (unsigned long long)stats[stage].histogram[i]);
+        }
+        printf("]}%s\n", stage == last_stage ? "" : ",");
+    }
+    printf("    }\n");
+}
+
+// first run includes session creation and is reported separately
+static bool benchmark_upscaler(
+    KomeliaOrt *ort,
+    VipsImage **pages,
+    int count
+) {
+    KomeliaOrtUpscaler *upscaler = komelia_ort_upscaler_create(ort);
+    komelia_ort_upscaler_set_execution_provider(upscaler, CPU, 0);
+    komelia_ort_upscaler_set_thread_count(upscaler, intra_op_threads, 0);
+    komelia_ort_upscaler_set_tile_size(upscaler, tile_size);
+    komelia_ort_upscaler_set_model_path(upscaler, upscaler_model);
+
+    GError *error = nullptr;
+    int64_t start = g_get_monotonic_time();
+    VipsImage *first = komelia_ort_upscale(upscaler, pages[0], &error);
+    int64_t first_run_us = g_get_monotonic_time() - start;
+    if (error != nullptr) {
+        fprintf(stderr, "upscale failed: %s\n", error->message);
+        g_error_free(error);
+        komelia_ort_upscaler_destroy(upscaler);
+        return false;
+    }
+    g_object_unref(first);
+
+    komelia_stage_stats_reset();
+    start = g_get_monotonic_time();
+    for (int i = 0; i < count; ++i) {
+        VipsImage *upscaled = komelia_ort_upscale(upscaler, pages[i], &error);
+        if (error != nullptr) {
+            fprintf(stderr, "upscale failed: %s\n", error->message);
+            g_error_free(error);
+            komelia_ort_upscaler_destroy(upscaler);
+            return false;
+        }
+        g_object_unref(upscaled);
+    }
+    int64_t total_us = g_get_monotonic_time() - start;
+    komelia_ort_upscaler_destroy(upscaler);
+
+    KomeliaStageStats stats[KOMELIA_STAGE_COUNT];
+    komelia_stage_stats_snapshot(stats);
+    uint64_t tiles = stats[KOMELIA_STAGE_UPSCALE_TENSOR_BUILD].count;
+    double total_seconds = (double)total_us / 1000000.0;
+
+    printf("  \"upscaler\": {\n");
+    printf("    \"pages\": %d,\n", count);
+    printf("    \"tiles\": %llu,\n", (unsigned long long)tiles);
+    printf("    \"first_run_ms\": %.3f,\n", (double)first_run_us / 1000.0);
+    printf("    \"total_ms\": %.3f,\n", (double)total_us / 1000.0);
+    printf("    \"pages_per_second\": %.3f,\n", count / total_seconds);
+    printf("    \"tiles_per_second\": %.3f,\n", (double)tiles / total_seconds);
+    print_stages(stats, KOMELIA_STAGE_UPSCALE_PREPROCESS, KOMELIA_STAGE_UPSCALE_JOIN);
+    printf("  },\n");
+    return true;
+}
+
+static bool benchmark_rf_detr(
+    KomeliaOrt *ort,
+    VipsImage **pages,
+    int count
+) {
+    KomeliaRfDetr *rf_detr = komelia_ort_rfdetr_create(ort);
+    komelia_ort_rfdetr_set_execution_provider(rf_detr, CPU, 0);
+    komelia_ort_rfdetr_set_thread_count(rf_detr, intra_op_threads, 0);
+    komelia_ort_rfdetr_set_model_path(rf_detr, rf_detr_model);
+
+    GError *error = nullptr;
+    int64_t start = g_get_monotonic_time();
+    KomeliaRfDetrResults *first = komelia_ort_rfdetr(rf_detr, pages[0], &error);
+    int64_t first_run_us = g_get_monotonic_time() - start;
+    if (error != nullptr) {
+        fprintf(stderr, "detection failed: %s\n", error->message);
+        g_error_free(error);
+        komelia_ort_rfdetr_destroy(rf_detr);
+        return false;
+    }
+    komelia_ort_rfdetr_release_result(rf_detr, first);
+
+    komelia_stage_stats_reset();
+    int detections = 0;
+    start = g_get_monotonic_time();
+    for (int i = 0; i < count; ++i) {
+        KomeliaRfDetrResults *results = komelia_ort_rfdetr(rf_detr, pages[i], &error);
+        if (error != nullptr) {
+            fprintf(stderr, "detection failed: %s\n", error->message);
+            g_error_free(error);
+            komelia_ort_rfdetr_destroy(rf_detr);
+            return false;
+        }
+        detections += results->results_size;
+        komelia_ort_rfdetr_release_result(rf_detr, results);
+    }
+    int64_t total_us = g_get_monotonic_time() - start;
+    komelia_ort_rfdetr_destroy(rf_detr);
+
+    KomeliaStageStats stats[KOMELIA_STAGE_COUNT];
+    komelia_stage_stats_snapshot(stats);
+
+    printf("  \"rf_detr\": {\n");
+    printf("    \"pages\": %d,\n", count);
+    printf("    \"detections\": %d,\n", detections);
+    printf("    \"first_run_ms\": %.3f,\n", (double)first_run_us / 1000.0);
+    printf("    \"total_ms\": %.3f,\n", (double)total_us / 1000.0);
+    printf("    \"pages_per_second\": %.3f,\n", count / ((double)total_us / 1000000.0));
+    print_stages(stats, KOMELIA_STAGE_RF_DETR_PREPROCESS, KOMELIA_STAGE_RF_DETR_POSTPROCESS);
+    printf("  },\n");
+    return true;
+}
+
+// live_allocations_start is the number of vips tracked allocations before benchmarks were run
+static void print_memory_usage(int live_allocations_start) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    // bytes on macOS
+    long long peak_rss_bytes = (long long)usage.ru_maxrss;
+#else
+    // kilobytes on linux
+    long long peak_rss_bytes = (long long)usage.ru_maxrss * 1024;
+#endif
+    printf("  \"memory\": {\n");
+    printf("    \"peak_rss_bytes\": %lld,\n", peak_rss_bytes);
+    // allocations that are still alive after benchmarks finished, non-zero value points to a leak
+    printf("    \"vips_live_allocations_delta\": %d,\n", vips_tracked_get_allocs() - live_allocations_start);
+    printf("    \"vips_peak_bytes\": %lld\n", (long long)vips_tracked_get_mem_highwater());
+    printf("  }\n");
+}
+
+int main(
+    int argc,
+    char **argv
+) {
+    if (VIPS_INIT(argv[0]))
+        vips_error_exit(nullptr);
+
+    GError *error = nullptr;
+    GOptionContext *context = g_option_context_new("- komelia onnxruntime benchmark");
+    g_option_context_add_main_entries(context, option_entries, nullptr);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        fprintf(stderr, "%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free(context);
+    if (upscaler_model == nullptr && rf_detr_model == nullptr) {
+        fprintf(stderr, "at least one of --upscaler-model or --rf-detr-model is required\n");
+        return 1;
+    }
+
+    KomeliaOrt *ort = komelia_ort_create(data_dir != nullptr ? data_dir : g_get_tmp_dir(), &error);
+    if (error != nullptr) {
+        fprintf(stderr, "%s\n", error->message);
+        return 1;
+    }
+
+    int count;
+    VipsImage **pages = load_pages(&count);
+    if (pages == nullptr)
+        return 1;
+
+    int live_allocations_start = vips_tracked_get_allocs();
+    bool success = true;
+    printf("{\n");
+    if (upscaler_model != nullptr) {
+        success = benchmark_upscaler(ort, pages, count);
+    }
+    if (success && rf_detr_model != nullptr) {
+        success = benchmark_rf_detr(ort, pages, count);
+    }
+    print_memory_usage(live_allocations_start);
+    printf("}\n");
+
+    for (int i = 0; i < count; ++i) {
+        g_object_unref(pages[i]);
+    }
+    free(pages);
+    komelia_ort_destroy(ort);
+    vips_shutdown();
+    return success ? 0 : 1;
+}
@@ -41,6 +41,16 @@ JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeRfDetr_setExec
     komelia_ort_rfdetr_set_execution_provider(rf_detr, provider_ordinal, device_id);
 }
 
+JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeRfDetr_setThreadCount(
+    JNIEnv *env,
+    jobject this,
+    jint intra_op_threads,
+    jint inter_op_threads
+) {
+    KomeliaRfDetr *rf_detr = get_rf_detr_from_jvm_handle(env, this);
+    komelia_ort_rfdetr_set_thread_count(rf_detr, intra_op_threads, inter_op_threads);
+}
+
 JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeRfDetr_setModelPath(
     JNIEnv *env,
     jobject this,
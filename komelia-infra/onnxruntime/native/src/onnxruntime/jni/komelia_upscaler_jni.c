@@ -42,6 +42,16 @@ JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeUpscaler_setEx
     komelia_ort_upscaler_set_execution_provider(upscaler, provider_ordinal, device_id);
 }
 
+JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeUpscaler_setThreadCount(
+    JNIEnv *env,
+    jobject this,
+    jint intra_op_threads,
+    jint inter_op_threads
+) {
+    KomeliaOrtUpscaler *upscaler = get_upscaler_from_jvm_handle(env, this);
+    komelia_ort_upscaler_set_thread_count(upscaler, intra_op_threads, inter_op_threads);
+}
+
 JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeUpscaler_setModelPath(
     JNIEnv *env,
     jobject this,
@@ -63,6 +73,55 @@ JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeUpscaler_setTi
     komelia_ort_upscaler_set_tile_size(upscaler, tile_size);
 }
 
+JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeUpscaler_setTileOverlap(
+    JNIEnv *env,
+    jobject this,
+    jint overlap
+) {
+    KomeliaOrtUpscaler *upscaler = get_upscaler_from_jvm_handle(env, this);
+    komelia_ort_upscaler_set_tile_overlap(upscaler, overlap);
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeUpscaler_setBatchSize(
+    JNIEnv *env,
+    jobject this,
+    jint max_batch_size,
+    jlong memory_limit
+) {
+    KomeliaOrtUpscaler *upscaler = get_upscaler_from_jvm_handle(env, this);
+    komelia_ort_upscaler_set_batch_size(upscaler, max_batch_size, (size_t)memory_limit);
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeUpscaler_setDiskOutput(
+    JNIEnv *env,
+    jobject this,
+    jboolean enabled
+) {
+    KomeliaOrtUpscaler *upscaler = get_upscaler_from_jvm_handle(env, this);
+    komelia_ort_upscaler_set_disk_output(upscaler, enabled);
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeUpscaler_setSessionCacheLimits(
+    JNIEnv *env,
+    jobject this,
+    jint max_sessions,
+    jlong memory_limit
+) {
+    KomeliaOrtUpscaler *upscaler = get_upscaler_from_jvm_handle(env, this);
+    komelia_ort_upscaler_set_session_cache_limits(upscaler, max_sessions, (size_t)memory_limit);
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeUpscaler_warmUp(
+    JNIEnv *env,
+    jobject this,
+    jstring model_path
+) {
+    KomeliaOrtUpscaler *upscaler = get_upscaler_from_jvm_handle(env, this);
+    const char *model_path_chars = (*env)->GetStringUTFChars(env, model_path, nullptr);
+    komelia_ort_upscaler_warm_up(upscaler, model_path_chars);
+    (*env)->ReleaseStringUTFChars(env, model_path, model_path_chars);
+}
+
 JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeUpscaler_closeCurrentSession(
     JNIEnv *env,
     jobject this
@@ -92,3 +151,74 @@ JNIEXPORT jobject JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeUpscaler_up
 
     return komelia_to_jvm_handle(env, result, nullptr);
 }
+
+JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeUpscaler_upscaleToFile(
+    JNIEnv *env,
+    jobject this,
+    jobject jvm_vips_image,
+    jstring path
+) {
+    VipsImage *image = komelia_from_jvm_handle(env, jvm_vips_image);
+    if (image == nullptr) {
+        return;
+    }
+
+    GError *upscale_error = nullptr;
+    KomeliaOrtUpscaler *upscaler = get_upscaler_from_jvm_handle(env, this);
+    const char *path_chars = (*env)->GetStringUTFChars(env, path, nullptr);
+    komelia_ort_upscale_to_file(upscaler, image, path_chars, &upscale_error);
+    (*env)->ReleaseStringUTFChars(env, path, path_chars);
+    if (upscale_error != nullptr) {
+        throw_jvm_ort_exception(env, upscale_error->message);
+        g_error_free(upscale_error);
+    }
+}
+
+JNIEXPORT jobject JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeUpscaler_upscaleRegion(
+    JNIEnv *env,
+    jobject this,
+    jobject jvm_vips_image,
+    jint left,
+    jint top,
+    jint right,
+    jint bottom,
+    jlong tile_cache_ptr
+) {
+    VipsImage *image = komelia_from_jvm_handle(env, jvm_vips_image);
+    if (image == nullptr) {
+        return nullptr;
+    }
+
+    VipsRect rect = {.left = left, .top = top, .width = right - left, .height = bottom - top};
+    GError *upscale_error = nullptr;
+    KomeliaOrtUpscaler *upscaler = get_upscaler_from_jvm_handle(env, this);
+    VipsImage *result = komelia_ort_upscale_region(
+        upscaler,
+        (KomeliaOrtTileCache *)tile_cache_ptr,
+        image,
+        &rect,
+        &upscale_error
+    );
+    if (upscale_error != nullptr) {
+        throw_jvm_ort_exception(env, upscale_error->message);
+        g_error_free(upscale_error);
+        return nullptr;
+    }
+
+    return komelia_to_jvm_handle(env, result, nullptr);
+}
+
+JNIEXPORT jlong JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeTileCache_create(
+    JNIEnv *env,
+    jobject this
+) {
+    return (int64_t)komelia_ort_tile_cache_create();
+}
+
+JNIEXPORT void JNICALL Java_snd_komelia_onnxruntime_JvmOnnxRuntimeTileCache_destroy(
+    JNIEnv *env,
+    jobject this,
+    jlong ptr
+) {
+    komelia_ort_tile_cache_destroy((KomeliaOrtTileCache *)ptr);
+}
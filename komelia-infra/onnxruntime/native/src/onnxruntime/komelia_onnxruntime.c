@@ -1,7 +1,9 @@
 #include "komelia_onnxruntime.h"
 #include "komelia_error.h"
 #include "komelia_matrix_ops.h"
+#include "komelia_tensor_conversions.h"
 
+#include <glib/gstdio.h>
 #include <onnxruntime_c_api.h>
 #include <vips/vips.h>
 #define APPNAME "Komelia"
@@ -14,14 +16,6 @@
 #endif
 #define KOMELIA_ORT_API_VERSION 21
 
-typedef struct {
-    char *input_name;
-    char **output_names;
-    size_t output_len;
-    OrtTypeInfo *input_info;
-    OrtValue *input_tensor;
-} InferenceData;
-
 void release_session(
     const OrtApi *ort_api,
     SessionData *session_data
@@ -44,20 +38,37 @@ void release_session(
         ort_api->ReleaseMemoryInfo(session_data->memory_info);
         session_data->memory_info = nullptr;
     }
+    if (session_data->input_info) {
+        ort_api->ReleaseTypeInfo((OrtTypeInfo *)session_data->input_info);
+        session_data->input_info = nullptr;
+    }
+    if (session_data->output_names) {
+        for (size_t i = 0; i < session_data->output_count; ++i) {
+            free(session_data->output_names[i]);
+        }
+        free(session_data->output_names);
+    }
+    free(session_data->input_name);
+    free(session_data->model_path);
+    pthread_mutex_destroy(&session_data->run_mutex);
     free(session_data);
 }
 
+// device arena grows by requested size instead of doubling, so it stays close to memory used by the model.
+// Arena is not limited if gpu_mem_limit is 0
 void enable_cuda(
     const OrtApi *ort_api,
     const int device_id,
+    const size_t gpu_mem_limit,
     OrtSessionOptions *options,
     GError **error
 ) {
     OrtCUDAProviderOptions cuda_options = {0};
     cuda_options.device_id = device_id;
     cuda_options.cudnn_conv_algo_search = OrtCudnnConvAlgoSearchHeuristic;
-    cuda_options.gpu_mem_limit = SIZE_MAX;
-    cuda_options.arena_extend_strategy = 0;
+    cuda_options.gpu_mem_limit = gpu_mem_limit != 0 ? gpu_mem_limit : SIZE_MAX;
+    // kSameAsRequested
+    cuda_options.arena_extend_strategy = 1;
     cuda_options.do_copy_in_default_stream = 1;
     cuda_options.has_user_compute_stream = 0;
     cuda_options.user_compute_stream = nullptr;
@@ -82,6 +93,7 @@ void enable_cuda(
 void enable_tensorrt(
     const OrtApi *ort_api,
     const int device_id,
+    const size_t gpu_mem_limit,
     const char *data_dir,
     OrtSessionOptions *options,
     GError **error
@@ -100,7 +112,7 @@ void enable_tensorrt(
     }
 
     GError *cuda_error = nullptr;
-    enable_cuda(ort_api, device_id, options, &cuda_error);
+    enable_cuda(ort_api, device_id, gpu_mem_limit, options, &cuda_error);
     if (cuda_error != nullptr) {
         g_propagate_error(error, cuda_error);
     }
@@ -109,14 +121,16 @@ void enable_tensorrt(
 void enable_rocm(
     const OrtApi *ort_api,
     const int device_id,
+    const size_t gpu_mem_limit,
     OrtSessionOptions *options,
     GError **error
 ) {
     OrtROCMProviderOptions rocm_opts = {0};
     rocm_opts.device_id = device_id;
     rocm_opts.miopen_conv_exhaustive_search = 0;
-    rocm_opts.gpu_mem_limit = SIZE_MAX;
-    rocm_opts.arena_extend_strategy = 0;
+    rocm_opts.gpu_mem_limit = gpu_mem_limit != 0 ? gpu_mem_limit : SIZE_MAX;
+    // kSameAsRequested
+    rocm_opts.arena_extend_strategy = 1;
     rocm_opts.do_copy_in_default_stream = 1;
     rocm_opts.has_user_compute_stream = 0;
     rocm_opts.user_compute_stream = nullptr;
@@ -183,15 +197,221 @@ void enable_dml(
 }
 #endif
 
+// copies names allocated by onnxruntime allocator to make session release independent of it
+static OrtStatus *copy_io_names(
+    const OrtApi *ort_api,
+    OrtAllocator *allocator,
+    SessionData *session,
+    size_t output_count
+) {
+    char *name = nullptr;
+    OrtStatus *ort_status = ort_api->SessionGetInputName(session->session, 0, allocator, &name);
+    if (ort_status != nullptr)
+        return ort_status;
+    session->input_name = strdup(name);
+    allocator->Free(allocator, name);
+
+    session->output_names = calloc(output_count, sizeof(char *));
+    session->output_count = output_count;
+    for (size_t i = 0; i < output_count; ++i) {
+        ort_status = ort_api->SessionGetOutputName(session->session, i, allocator, &name);
+        if (ort_status != nullptr)
+            return ort_status;
+        session->output_names[i] = strdup(name);
+        allocator->Free(allocator, name);
+    }
+    return nullptr;
+}
+
+static const char *get_provider_name(KomeliaOrtExecutionProvider execution_provider) {
+    switch (execution_provider) {
+    case CPU:
+        return "cpu";
+    case CUDA:
+        return "cuda";
+    case ROCm:
+        return "rocm";
+    default:
+        return nullptr;
+    }
+}
+
+// identifies model file by its path, size and modification time.
+// Model files are replaced on update, reading the whole file on every session creation is not needed
+static char *get_model_key(const char *path) {
+    GStatBuf stat;
+    if (g_stat(path, &stat) != 0)
+        return nullptr;
+
+    char *model_id = g_strdup_printf(
+        "%s:%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT,
+        path,
+        (gint64)stat.st_size,
+        (gint64)stat.st_mtime
+    );
+    char *key = g_compute_checksum_for_string(G_CHECKSUM_SHA256, model_id, -1);
+    g_free(model_id);
+    return key;
+}
+
+// Path of model with applied graph optimizations in ORT format.
+// Optimized graph may contain provider specific kernels and layouts chosen for the cpu instruction set.
+// It is only valid for the same provider, cpu target and onnxruntime version.
+// Returns nullptr if provider doesn't support serialization of optimized model.
+// TensorRT uses its own engine cache. DirectML and WebGPU fuse graph into nodes that can't be serialized
+static char *get_optimized_model_path(
+    const char *data_dir,
+    KomeliaOrtExecutionProvider execution_provider,
+    const char *model_path
+) {
+    const char *provider_name = get_provider_name(execution_provider);
+    if (provider_name == nullptr || data_dir == nullptr)
+        return nullptr;
+
+    char *cache_dir = g_build_filename(data_dir, "optimized_models", nullptr);
+    if (g_mkdir_with_parents(cache_dir, 0755) != 0) {
+        g_free(cache_dir);
+        return nullptr;
+    }
+
+    char *model_key = get_model_key(model_path);
+    if (model_key == nullptr) {
+        g_free(cache_dir);
+        return nullptr;
+    }
+
+    char *file_name = g_strdup_printf(
+        "%s_%s_%s_%s.ort",
+        model_key,
+        provider_name,
+        komelia_cpu_target_name(),
+        OrtGetApiBase()->GetVersionString()
+    );
+    char *optimized_model_path = g_build_filename(cache_dir, file_name, nullptr);
+    g_free(file_name);
+    g_free(model_key);
+    g_free(cache_dir);
+    return optimized_model_path;
+}
+
+static OrtStatus *create_ort_session(
+    const OrtApi *ort_api,
+    const OrtEnv *ort_env,
+    const char *model_path,
+    OrtSessionOptions *options,
+    OrtSession **session
+) {
+#ifdef _WIN32
+    wchar_t *wide_model_path = fromUTF8(model_path, 0, nullptr);
+    OrtStatus *ort_status = ort_api->CreateSession(ort_env, wide_model_path, options, session);
+    free(wide_model_path);
+    return ort_status;
+#else
+    return ort_api->CreateSession(ort_env, model_path, options, session);
+#endif
+}
+
+static OrtStatus *set_optimized_model_output(
+    const OrtApi *ort_api,
+    OrtSessionOptions *options,
+    const char *output_path
+) {
+    OrtStatus *ort_status = ort_api->AddSessionConfigEntry(options, "session.save_model_format", "ORT");
+    if (ort_status != nullptr)
+        return ort_status;
+#ifdef _WIN32
+    wchar_t *wide_output_path = fromUTF8(output_path, 0, nullptr);
+    ort_status = ort_api->SetOptimizedModelFilePath(options, wide_output_path);
+    free(wide_output_path);
+    return ort_status;
+#else
+    return ort_api->SetOptimizedModelFilePath(options, output_path);
+#endif
+}
+
+// Loads previously optimized model if it exists. Otherwise, optimizes original model
+// and saves the result for the next session creation
+static OrtStatus *create_optimized_session(
+    KomeliaOrt *komelia_ort,
+    SessionData *session
+) {
+    const OrtApi *ort_api = komelia_ort->ort_api;
+    char *optimized_model_path = get_optimized_model_path(
+        komelia_ort->data_dir,
+        session->execution_provider,
+        session->model_path
+    );
+
+    OrtStatus *ort_status;
+    if (optimized_model_path != nullptr && g_file_test(optimized_model_path, G_FILE_TEST_EXISTS)) {
+        // graph optimizations are already applied
+        ort_status = ort_api->SetSessionGraphOptimizationLevel(session->session_options, ORT_DISABLE_ALL);
+        if (ort_status != nullptr) {
+            g_free(optimized_model_path);
+            return ort_status;
+        }
+
+        ort_status = create_ort_session(
+            ort_api,
+            komelia_ort->ort_env,
+            optimized_model_path,
+            session->session_options,
+            &session->session
+        );
+        if (ort_status == nullptr) {
+            g_free(optimized_model_path);
+            return nullptr;
+        }
+        // stale or corrupted file, replaced below
+        ort_api->ReleaseStatus(ort_status);
+        g_remove(optimized_model_path);
+    }
+
+    ort_status = ort_api->SetSessionGraphOptimizationLevel(session->session_options, ORT_ENABLE_ALL);
+    if (ort_status != nullptr) {
+        g_free(optimized_model_path);
+        return ort_status;
+    }
+
+    // written to temporary file first. Sessions for the same model can be created concurrently
+    char *temp_model_path = nullptr;
+    if (optimized_model_path != nullptr) {
+        temp_model_path = g_strdup_printf("%s.%p.tmp", optimized_model_path, (void *)session);
+        ort_status = set_optimized_model_output(ort_api, session->session_options, temp_model_path);
+        if (ort_status != nullptr) {
+            g_free(temp_model_path);
+            g_free(optimized_model_path);
+            return ort_status;
+        }
+    }
+
+    ort_status = create_ort_session(
+        ort_api,
+        komelia_ort->ort_env,
+        session->model_path,
+        session->session_options,
+        &session->session
+    );
+    if (temp_model_path != nullptr) {
+        if (ort_status != nullptr || g_rename(temp_model_path, optimized_model_path) != 0) {
+            g_remove(temp_model_path);
+        }
+        g_free(temp_model_path);
+    }
+    g_free(optimized_model_path);
+    return ort_status;
+}
+
 SessionData *komelia_ort_create_session(
     KomeliaOrt *komelia_ort,
     KomeliaOrtExecutionProvider execution_provider,
     int device_id,
     char *model_path,
+    KomeliaOrtThreadConfig threads,
+    size_t gpu_mem_limit,
     GError **error
 ) {
     const OrtApi *ort_api = komelia_ort->ort_api;
-    const OrtEnv *ort_env = komelia_ort->ort_env;
 
     SessionData *session = malloc(sizeof(SessionData));
     session->session_options = nullptr;
@@ -200,20 +420,42 @@ SessionData *komelia_ort_create_session(
     session->run_options = nullptr;
     session->input_info = nullptr;
     session->input_tensor_info = nullptr;
+    session->input_name = nullptr;
+    session->output_names = nullptr;
+    session->output_count = 0;
     session->execution_provider = execution_provider;
     session->device_id = device_id;
     session->model_path = strdup(model_path);
+    session->threads = threads;
+    session->serialize_run = execution_provider == DML;
+    pthread_mutex_init(&session->run_mutex, nullptr);
 
     OrtStatus *ort_status = ort_api->CreateSessionOptions(&session->session_options);
     if (ort_status != nullptr) {
         goto on_error;
     }
 
-    ort_status =
-        ort_api->SetSessionGraphOptimizationLevel(session->session_options, ORT_ENABLE_ALL);
-
-    if (ort_status != nullptr) {
-        goto on_error;
+    if (threads.intra_op_threads > 0) {
+        ort_status =
+            ort_api->SetIntraOpNumThreads(session->session_options, threads.intra_op_threads);
+        if (ort_status != nullptr) {
+            goto on_error;
+        }
+    }
+    if (threads.inter_op_threads > 0) {
+        ort_status =
+            ort_api->SetInterOpNumThreads(session->session_options, threads.inter_op_threads);
+        if (ort_status != nullptr) {
+            goto on_error;
+        }
+    }
+    // inter op threads are only used in parallel execution mode.
+    // DirectML provider resets it back to sequential
+    if (threads.inter_op_threads > 1) {
+        ort_status = ort_api->SetSessionExecutionMode(session->session_options, ORT_PARALLEL);
+        if (ort_status != nullptr) {
+            goto on_error;
+        }
     }
 
     GError *provider_init_error = nullptr;
@@ -222,16 +464,17 @@ SessionData *komelia_ort_create_session(
         enable_tensorrt(
             ort_api,
             device_id,
+            gpu_mem_limit,
             komelia_ort->data_dir,
             session->session_options,
             &provider_init_error
         );
         break;
     case CUDA:
-        enable_cuda(ort_api, device_id, session->session_options, &provider_init_error);
+        enable_cuda(ort_api, device_id, gpu_mem_limit, session->session_options, &provider_init_error);
         break;
     case ROCm:
-        enable_rocm(ort_api, device_id, session->session_options, &provider_init_error);
+        enable_rocm(ort_api, device_id, gpu_mem_limit, session->session_options, &provider_init_error);
         break;
 #ifdef USE_DML
     case DML:
@@ -247,23 +490,11 @@ SessionData *komelia_ort_create_session(
 
     if (provider_init_error != nullptr) {
         g_propagate_error(error, provider_init_error);
+        release_session(ort_api, session);
         return nullptr;
     }
 
-#ifdef _WIN32
-    wchar_t *wide_model_path = fromUTF8(session->model_path, 0, nullptr);
-    ort_status =
-        ort_api
-            ->CreateSession(ort_env, wide_model_path, session->session_options, &session->session);
-    free(wide_model_path);
-#else
-    ort_status = ort_api->CreateSession(
-        ort_env,
-        session->model_path,
-        session->session_options,
-        &session->session
-    );
-#endif
+    ort_status = create_optimized_session(komelia_ort, session);
     if (ort_status != nullptr) {
         goto on_error;
     }
@@ -284,6 +515,8 @@ SessionData *komelia_ort_create_session(
     if (ort_status != nullptr) {
         goto on_error;
     }
+    session->input_info = input_info;
+
     const OrtTensorTypeAndShapeInfo *input_tensor_info;
     ort_status = ort_api->CastTypeInfoToTensorInfo(input_info, &input_tensor_info);
     if (ort_status != nullptr) {
@@ -295,22 +528,36 @@ SessionData *komelia_ort_create_session(
     if (ort_status != nullptr) {
         goto on_error;
     }
-    size_t input_count;
     size_t output_count;
-    ort_status = ort_api->SessionGetInputCount(session->session, &input_count);
-    if (ort_status != nullptr) {
-        goto on_error;
-    }
     ort_status = ort_api->SessionGetOutputCount(session->session, &output_count);
     if (ort_status != nullptr) {
         goto on_error;
     }
 
-    session->input_info = input_info;
     session->input_tensor_info = input_tensor_info;
     session->input_data_type = input_element_type;
-    // session->input_count = input_count;
-    session->output_count = output_count;
+
+    size_t input_dims_count;
+    ort_status = ort_api->GetDimensionsCount(input_tensor_info, &input_dims_count);
+    if (ort_status != nullptr) {
+        goto on_error;
+    }
+    session->dynamic_batch = false;
+    if (input_dims_count == 4) {
+        int64_t input_dims[4];
+        ort_status = ort_api->GetDimensions(input_tensor_info, input_dims, input_dims_count);
+        if (ort_status != nullptr) {
+            goto on_error;
+        }
+        // dynamic dimensions are reported as -1
+        session->dynamic_batch = input_dims[0] < 0;
+    }
+
+    // names are resolved once per session. Inference only binds input tensor
+    ort_status = copy_io_names(ort_api, komelia_ort->ort_allocator, session, output_count);
+    if (ort_status != nullptr) {
+        goto on_error;
+    }
     return session;
 
 on_error:
@@ -357,36 +604,10 @@ KomeliaOrt *komelia_ort_create(
     komelia_ort->ort_env = ort_env;
     komelia_ort->ort_allocator = ort_default_allocator;
     komelia_ort->data_dir = strdup(data_dir);
-    pthread_mutex_init(&komelia_ort->mutex, nullptr);
 
     return komelia_ort;
 }
 
-static void release_inference_data(
-    const OrtApi *ort_api,
-    OrtAllocator *allocator,
-    InferenceData *inference_data
-) {
-    if (inference_data == nullptr) {
-        return;
-    }
-
-    if (inference_data->input_name != nullptr) {
-        allocator->Free(allocator, inference_data->input_name);
-    }
-    if (inference_data->output_names != nullptr) {
-        for (int i = 0; i < inference_data->output_len; ++i) {
-            if (inference_data->output_names[i] != nullptr)
-                allocator->Free(allocator, inference_data->output_names[i]);
-        }
-        free(inference_data->output_names);
-    }
-    if (inference_data->input_tensor != nullptr) {
-        ort_api->ReleaseValue(inference_data->input_tensor);
-    }
-    free(inference_data);
-}
-
 static OrtValue *create_tensor(
     const OrtApi *ort_api,
     const SessionData *session,
@@ -409,103 +630,26 @@ static OrtValue *create_tensor(
     return ort_tensor;
 }
 
-static InferenceData *prepare_inference_data(
-    KomeliaOrt *komelia_ort,
-    SessionData *session,
-    const KomeliaOrtInputTensor *input,
-    GError **error
-) {
-
-    InferenceData *inference_data = malloc(sizeof(InferenceData));
-    inference_data->output_names = malloc(sizeof(char *) * session->output_count);
-    inference_data->output_len = session->output_count;
-    inference_data->input_info = nullptr;
-    inference_data->input_tensor = nullptr;
-
-    const OrtApi *ort_api = komelia_ort->ort_api;
-    OrtAllocator *ort_allocator = komelia_ort->ort_allocator;
-
-    OrtStatus *ort_status =
-        ort_api->SessionGetInputTypeInfo(session->session, 0, &inference_data->input_info);
-    if (ort_status != nullptr)
-        goto inference_error;
-
-    const OrtTensorTypeAndShapeInfo *input_tensor_info;
-    ort_status = ort_api->CastTypeInfoToTensorInfo(inference_data->input_info, &input_tensor_info);
-    if (ort_status != nullptr)
-        goto inference_error;
-
-    ONNXTensorElementDataType input_element_type;
-    ort_status = ort_api->GetTensorElementType(input_tensor_info, &input_element_type);
-    if (ort_status != nullptr)
-        goto inference_error;
-
-    GError *tensor_create_error = nullptr;
-    OrtValue *input_tensor = create_tensor(ort_api, session, input, &tensor_create_error);
-    if (tensor_create_error != nullptr) {
-        g_propagate_error(error, tensor_create_error);
-        release_inference_data(ort_api, ort_allocator, inference_data);
-        return nullptr;
-    }
-    inference_data->input_tensor = input_tensor;
-    ort_status = ort_api->SessionGetInputName(
-        session->session,
-        0,
-        komelia_ort->ort_allocator,
-        &inference_data->input_name
-    );
-
-    if (ort_status != nullptr)
-        goto inference_error;
-
-    for (int i = 0; i < session->output_count; ++i) {
-        char *out_name = nullptr;
-        ort_status =
-            ort_api
-                ->SessionGetOutputName(session->session, i, komelia_ort->ort_allocator, &out_name);
-        inference_data->output_names[i] = out_name;
-        if (ort_status != nullptr)
-            goto inference_error;
-    }
-    return inference_data;
-inference_error:
-    wrap_ort_error(ort_api, ort_status, KOMELIA_ORT_ERROR_INFERENCE, error);
-    release_inference_data(ort_api, ort_allocator, inference_data);
-    return nullptr;
-}
-
 static InferenceResult *run_inference(
-    KomeliaOrt *komelia_ort,
+    const OrtApi *ort_api,
     SessionData *session,
-    InferenceData *inference_data,
+    const OrtValue *input_tensor,
     GError **error
 ) {
-    const OrtApi *ort_api = komelia_ort->ort_api;
-    OrtAllocator *ort_allocator = komelia_ort->ort_allocator;
-
-    size_t out_len = inference_data->output_len;
-    // OrtValue *output_tensors = nullptr;
-    OrtValue **output_tensors = malloc(sizeof(OrtValue *) * out_len);
-    for (int i = 0; i < out_len; ++i) {
-        output_tensors[i] = nullptr;
-    }
+    size_t out_len = session->output_count;
+    OrtValue **output_tensors = calloc(out_len, sizeof(OrtValue *));
     OrtTensorTypeAndShapeInfo **out_tensors_info =
         calloc(out_len, sizeof(OrtTensorTypeAndShapeInfo *));
 
-    const char *input_names[1];
-    const char *output_names[2];
-    input_names[0] = inference_data->input_name;
-    output_names[0] = inference_data->output_names[0];
-    output_names[1] = inference_data->output_names[1];
-    const OrtValue *inputs[1];
-    inputs[0] = inference_data->input_tensor;
+    const char *input_names[1] = {session->input_name};
+    const OrtValue *inputs[1] = {input_tensor};
     OrtStatus *ort_status = ort_api->Run(
         session->session,
         session->run_options,
         input_names,
         inputs,
         1,
-        output_names,
+        (const char *const *)session->output_names,
         out_len,
         output_tensors
     );
@@ -513,13 +657,12 @@ static InferenceResult *run_inference(
         goto inference_error;
     }
 
-    for (int i = 0; i < out_len; ++i) {
+    for (size_t i = 0; i < out_len; ++i) {
         ort_status = ort_api->GetTensorTypeAndShape(output_tensors[i], &out_tensors_info[i]);
         if (ort_status != nullptr)
             goto inference_error;
     }
 
-    release_inference_data(ort_api, ort_allocator, inference_data);
     InferenceResult *result = malloc(sizeof(InferenceResult));
     result->out_tensors_info = out_tensors_info;
     result->output_tensors = output_tensors;
@@ -527,7 +670,12 @@ static InferenceResult *run_inference(
     return result;
 inference_error:
     wrap_ort_error(ort_api, ort_status, KOMELIA_ORT_ERROR_INFERENCE, error);
-    release_inference_data(ort_api, ort_allocator, inference_data);
+    for (size_t i = 0; i < out_len; ++i) {
+        if (out_tensors_info[i] != nullptr)
+            ort_api->ReleaseTensorTypeAndShapeInfo(out_tensors_info[i]);
+        if (output_tensors[i] != nullptr)
+            ort_api->ReleaseValue(output_tensors[i]);
+    }
     free(output_tensors);
     free(out_tensors_info);
     return nullptr;
@@ -539,32 +687,34 @@ InferenceResult *komelia_ort_run_inference(
     const KomeliaOrtInputTensor *input,
     GError **error
 ) {
-    pthread_mutex_lock(&komelia_ort->mutex);
-    GError *prepare_error = nullptr;
-    InferenceData *inference_data =
-        prepare_inference_data(komelia_ort, session, input, &prepare_error);
-
-    if (prepare_error != nullptr) {
-        g_propagate_error(error, prepare_error);
-        pthread_mutex_unlock(&komelia_ort->mutex);
+    const OrtApi *ort_api = komelia_ort->ort_api;
+    GError *tensor_create_error = nullptr;
+    OrtValue *input_tensor = create_tensor(ort_api, session, input, &tensor_create_error);
+    if (tensor_create_error != nullptr) {
+        g_propagate_error(error, tensor_create_error);
         return nullptr;
     }
 
+    if (session->serialize_run)
+        pthread_mutex_lock(&session->run_mutex);
+
     GError *inference_error = nullptr;
-    InferenceResult *result = run_inference(komelia_ort, session, inference_data, &inference_error);
+    InferenceResult *result = run_inference(ort_api, session, input_tensor, &inference_error);
+
+    if (session->serialize_run)
+        pthread_mutex_unlock(&session->run_mutex);
+
+    ort_api->ReleaseValue(input_tensor);
     if (inference_error != nullptr) {
         g_propagate_error(error, inference_error);
-        pthread_mutex_unlock(&komelia_ort->mutex);
         return nullptr;
     }
-    pthread_mutex_unlock(&komelia_ort->mutex);
     return result;
 }
 
 void komelia_ort_destroy(KomeliaOrt *komelia_ort) {
     komelia_ort->ort_api->ReleaseEnv(komelia_ort->ort_env);
     free(komelia_ort->data_dir);
-    pthread_mutex_destroy(&komelia_ort->mutex);
     free(komelia_ort);
 }
 
@@ -586,3 +736,228 @@ void komelia_ort_release_inference_result(
     free(result->output_tensors);
     free(result);
 }
+
+static const char *get_pinned_memory_name(KomeliaOrtExecutionProvider execution_provider) {
+    switch (execution_provider) {
+    case TENSOR_RT:
+    case CUDA:
+        return "CudaPinned";
+    case ROCm:
+        return "HipPinned";
+    default:
+        return nullptr;
+    }
+}
+
+// pinned allocator is optional, buffers fall back to default cpu allocator if it's not available
+static void create_pinned_allocator(
+    const OrtApi *ort_api,
+    SessionData *session,
+    KomeliaOrtIoBuffers *buffers
+) {
+    const char *pinned_memory_name = get_pinned_memory_name(session->execution_provider);
+    if (pinned_memory_name == nullptr)
+        return;
+
+    OrtStatus *ort_status = ort_api->CreateMemoryInfo(
+        pinned_memory_name,
+        OrtDeviceAllocator,
+        session->device_id,
+        OrtMemTypeCPUOutput,
+        &buffers->pinned_memory_info
+    );
+    if (ort_status != nullptr) {
+        ort_api->ReleaseStatus(ort_status);
+        buffers->pinned_memory_info = nullptr;
+        return;
+    }
+
+    ort_status = ort_api->CreateAllocator(
+        session->session,
+        buffers->pinned_memory_info,
+        &buffers->pinned_allocator
+    );
+    if (ort_status != nullptr) {
+        ort_api->ReleaseStatus(ort_status);
+        ort_api->ReleaseMemoryInfo(buffers->pinned_memory_info);
+        buffers->pinned_memory_info = nullptr;
+        buffers->pinned_allocator = nullptr;
+    }
+}
+
+KomeliaOrtIoBuffers *komelia_ort_create_io_buffers(
+    KomeliaOrt *komelia_ort,
+    SessionData *session,
+    const int64_t *input_shape,
+    size_t input_shape_len,
+    GError **error
+) {
+    const OrtApi *ort_api = komelia_ort->ort_api;
+    KomeliaOrtIoBuffers *buffers = calloc(1, sizeof(KomeliaOrtIoBuffers));
+    buffers->input_shape = malloc(sizeof(int64_t) * input_shape_len);
+    memcpy(buffers->input_shape, input_shape, sizeof(int64_t) * input_shape_len);
+    buffers->input_shape_len = input_shape_len;
+
+    OrtStatus *ort_status = ort_api->CreateIoBinding(session->session, &buffers->io_binding);
+    if (ort_status != nullptr)
+        goto on_error;
+
+    create_pinned_allocator(ort_api, session, buffers);
+    OrtAllocator *allocator = buffers->pinned_allocator != nullptr
+                                  ? buffers->pinned_allocator
+                                  : komelia_ort->ort_allocator;
+    const OrtMemoryInfo *output_memory_info = buffers->pinned_memory_info != nullptr
+                                                  ? buffers->pinned_memory_info
+                                                  : session->memory_info;
+
+    ort_status = ort_api->CreateTensorAsOrtValue(
+        allocator,
+        input_shape,
+        input_shape_len,
+        session->input_data_type,
+        &buffers->input_tensor
+    );
+    if (ort_status != nullptr)
+        goto on_error;
+    ort_status = ort_api->GetTensorMutableData(buffers->input_tensor, &buffers->input_data);
+    if (ort_status != nullptr)
+        goto on_error;
+
+    size_t element_count = 1;
+    for (size_t i = 0; i < input_shape_len; ++i) {
+        element_count *= input_shape[i];
+    }
+    size_t element_size =
+        session->input_data_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16 ? sizeof(_Float16) : sizeof(float);
+    buffers->input_data_len = element_count * element_size;
+
+    ort_status =
+        ort_api->BindInput(buffers->io_binding, session->input_name, buffers->input_tensor);
+    if (ort_status != nullptr)
+        goto on_error;
+
+    // output shape is not known until the first run
+    for (size_t i = 0; i < session->output_count; ++i) {
+        ort_status = ort_api->BindOutputToDevice(
+            buffers->io_binding,
+            session->output_names[i],
+            output_memory_info
+        );
+        if (ort_status != nullptr)
+            goto on_error;
+    }
+    return buffers;
+
+on_error:
+    wrap_ort_error(ort_api, ort_status, KOMELIA_ORT_ERROR_INFERENCE, error);
+    komelia_ort_release_io_buffers(komelia_ort, buffers);
+    return nullptr;
+}
+
+// takes ownership of output tensors allocated by the first run and binds them for reuse
+static InferenceResult *bind_output_tensors(
+    KomeliaOrt *komelia_ort,
+    SessionData *session,
+    KomeliaOrtIoBuffers *buffers,
+    GError **error
+) {
+    const OrtApi *ort_api = komelia_ort->ort_api;
+    OrtAllocator *allocator = komelia_ort->ort_allocator;
+    OrtValue **bound_values = nullptr;
+    size_t bound_count = 0;
+    OrtStatus *ort_status =
+        ort_api->GetBoundOutputValues(buffers->io_binding, allocator, &bound_values, &bound_count);
+    if (ort_status != nullptr) {
+        wrap_ort_error(ort_api, ort_status, KOMELIA_ORT_ERROR_INFERENCE, error);
+        return nullptr;
+    }
+
+    InferenceResult *result = malloc(sizeof(InferenceResult));
+    result->output_tensors = malloc(sizeof(OrtValue *) * bound_count);
+    result->out_tensors_info = calloc(bound_count, sizeof(OrtTensorTypeAndShapeInfo *));
+    result->output_len = bound_count;
+    memcpy(result->output_tensors, bound_values, sizeof(OrtValue *) * bound_count);
+    allocator->Free(allocator, bound_values);
+
+    for (size_t i = 0; i < bound_count; ++i) {
+        ort_status =
+            ort_api->GetTensorTypeAndShape(result->output_tensors[i], &result->out_tensors_info[i]);
+        if (ort_status != nullptr)
+            goto on_error;
+        ort_status = ort_api->BindOutput(
+            buffers->io_binding,
+            session->output_names[i],
+            result->output_tensors[i]
+        );
+        if (ort_status != nullptr)
+            goto on_error;
+    }
+    return result;
+
+on_error:
+    wrap_ort_error(ort_api, ort_status, KOMELIA_ORT_ERROR_INFERENCE, error);
+    for (size_t i = 0; i < bound_count; ++i) {
+        if (result->out_tensors_info[i] != nullptr)
+            ort_api->ReleaseTensorTypeAndShapeInfo(result->out_tensors_info[i]);
+        ort_api->ReleaseValue(result->output_tensors[i]);
+    }
+    free(result->out_tensors_info);
+    free(result->output_tensors);
+    free(result);
+    return nullptr;
+}
+
+InferenceResult *komelia_ort_run_io_binding(
+    KomeliaOrt *komelia_ort,
+    SessionData *session,
+    KomeliaOrtIoBuffers *buffers,
+    GError **error
+) {
+    const OrtApi *ort_api = komelia_ort->ort_api;
+    if (session->serialize_run)
+        pthread_mutex_lock(&session->run_mutex);
+
+    OrtStatus *ort_status =
+        ort_api->RunWithBinding(session->session, session->run_options, buffers->io_binding);
+
+    if (session->serialize_run)
+        pthread_mutex_unlock(&session->run_mutex);
+
+    if (ort_status != nullptr) {
+        wrap_ort_error(ort_api, ort_status, KOMELIA_ORT_ERROR_INFERENCE, error);
+        return nullptr;
+    }
+
+    if (buffers->output == nullptr) {
+        GError *bind_error = nullptr;
+        buffers->output = bind_output_tensors(komelia_ort, session, buffers, &bind_error);
+        if (bind_error != nullptr) {
+            g_propagate_error(error, bind_error);
+            return nullptr;
+        }
+    }
+    return buffers->output;
+}
+
+void komelia_ort_release_io_buffers(
+    KomeliaOrt *komelia_ort,
+    KomeliaOrtIoBuffers *buffers
+) {
+    if (buffers == nullptr)
+        return;
+    const OrtApi *ort_api = komelia_ort->ort_api;
+
+    if (buffers->io_binding != nullptr)
+        ort_api->ReleaseIoBinding(buffers->io_binding);
+    if (buffers->input_tensor != nullptr)
+        ort_api->ReleaseValue(buffers->input_tensor);
+    if (buffers->output != nullptr)
+        komelia_ort_release_inference_result(komelia_ort, buffers->output);
+    // tensors must be released before the allocator they were allocated with
+    if (buffers->pinned_allocator != nullptr)
+        ort_api->ReleaseAllocator(buffers->pinned_allocator);
+    if (buffers->pinned_memory_info != nullptr)
+        ort_api->ReleaseMemoryInfo(buffers->pinned_memory_info);
+    free(buffers->input_shape);
+    free(buffers);
+}
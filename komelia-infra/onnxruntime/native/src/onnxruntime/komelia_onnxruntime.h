@@ -22,6 +22,12 @@ typedef struct {
     int height;
 } KomeliaRect;
 
+// 0 leaves thread count selection to onnxruntime
+typedef struct {
+    int intra_op_threads;
+    int inter_op_threads;
+} KomeliaOrtThreadConfig;
+
 typedef struct {
     OrtSessionOptions *session_options;
     OrtSession *session;
@@ -30,12 +36,21 @@ typedef struct {
     const OrtTypeInfo *input_info;
     const OrtTensorTypeAndShapeInfo *input_tensor_info;
     ONNXTensorElementDataType input_data_type;
+    // model accepts more than one image per run
+    bool dynamic_batch;
 
     KomeliaOrtExecutionProvider execution_provider;
     int device_id;
     char *model_path;
-    // size_t input_count;
+    char *input_name;
+    char **output_names;
     size_t output_count;
+    KomeliaOrtThreadConfig threads;
+
+    // Run is thread safe for most execution providers.
+    // Concurrent runs are only serialized for providers that don't support it (DirectML)
+    bool serialize_run;
+    pthread_mutex_t run_mutex;
 } SessionData;
 
 typedef struct {
@@ -56,9 +71,23 @@ typedef struct {
     OrtEnv *ort_env;
     OrtAllocator *ort_allocator;
     char *data_dir;
-    pthread_mutex_t mutex;
 } KomeliaOrt;
 
+// Input and output tensors bound to a session and reused by all runs with the same input shape.
+// Host memory is pinned for gpu providers that support it to speed up device transfers
+typedef struct {
+    OrtIoBinding *io_binding;
+    OrtMemoryInfo *pinned_memory_info;
+    OrtAllocator *pinned_allocator;
+    int64_t *input_shape;
+    size_t input_shape_len;
+    OrtValue *input_tensor;
+    void *input_data;
+    size_t input_data_len;
+    // allocated by the first run. Next runs write to the same output tensors
+    InferenceResult *output;
+} KomeliaOrtIoBuffers;
+
 static void wrap_ort_error(
     const OrtApi *ort_api,
     OrtStatus *ort_status,
@@ -87,11 +116,14 @@ KomeliaOrt *komelia_ort_create(
 
 void komelia_ort_destroy(KomeliaOrt *komelia_ort);
 
+// gpu_mem_limit caps device memory arena of CUDA, TensorRT and ROCm sessions, 0 for no limit
 SessionData *komelia_ort_create_session(
     KomeliaOrt *komelia_ort,
     KomeliaOrtExecutionProvider execution_provider,
     int device_id,
     char *model_path,
+    KomeliaOrtThreadConfig threads,
+    size_t gpu_mem_limit,
     GError **error
 );
 void komelia_ort_close_session(
@@ -111,4 +143,26 @@ void komelia_ort_release_inference_result(
     InferenceResult *result
 );
 
+KomeliaOrtIoBuffers *komelia_ort_create_io_buffers(
+    KomeliaOrt *komelia_ort,
+    SessionData *session,
+    const int64_t *input_shape,
+    size_t input_shape_len,
+    GError **error
+);
+
+// runs inference on current content of input_data.
+// Returned result is owned by buffers and is overwritten by the next run
+InferenceResult *komelia_ort_run_io_binding(
+    KomeliaOrt *komelia_ort,
+    SessionData *session,
+    KomeliaOrtIoBuffers *buffers,
+    GError **error
+);
+
+void komelia_ort_release_io_buffers(
+    KomeliaOrt *komelia_ort,
+    KomeliaOrtIoBuffers *buffers
+);
+
 #endif // KOMELIA_ONNXRUNTIME_H
@@ -1,45 +1,20 @@
 #include "komelia_ort_rf_detr.h"
-#include "komelia_matrix_ops.h"
+#include "komelia_tensor_conversions.h"
+#include "komelia_stage_stats.h"
 #include <math.h>
 
 static float MEANS[3] = {0.485f, 0.456f, 0.406f};
 static float STDS[3] = {0.229f, 0.224f, 0.225f};
 static float confidence_threshold = 0.5f;
 
-static void hwc_to_chw(
-    const uint8_t *input,
-    size_t height,
-    size_t width,
-    /*,size_t channels,*/
-    float *output
-) {
-    size_t stride_size = height * width;
-#pragma omp parallel for shared(stride_size, input, output, MEANS, STDS) default(none) collapse(2)
-    for (size_t i = 0; i != stride_size; ++i) {
-        for (size_t c = 0; c != 3; ++c) {
-            const float value = input[i * 3 + c];
-            const float normalized = ((value / 255.0f) - MEANS[c]) / STDS[c];
-            output[c * stride_size + i] = normalized;
-        }
-    }
-}
-
-static void hwc_to_chw_f16(
-    const uint8_t *input,
-    size_t height,
-    size_t width,
-    /*,size_t channels,*/
-    _Float16 *output
-) {
-    size_t stride_size = height * width;
-#pragma omp parallel for shared(stride_size, input, output, MEANS, STDS) default(none) collapse(2)
-    for (size_t i = 0; i != stride_size; ++i) {
-        for (size_t c = 0; c != 3; ++c) {
-            const float value = input[i * 3 + c];
-            const float normalized = ((value / 255.0f) - MEANS[c]) / STDS[c];
-            output[c * stride_size + i] = (_Float16)normalized;
-        }
+// normalization with MEANS and STDS fused into per channel scale and bias
+static KomeliaTensorNormalization get_normalization() {
+    KomeliaTensorNormalization normalization;
+    for (int c = 0; c < 3; ++c) {
+        normalization.scale[c] = 1.0f / (255.0f * STDS[c]);
+        normalization.bias[c] = -MEANS[c] / STDS[c];
     }
+    return normalization;
 }
 
 static KomeliaOrtInputTensor *create_tensor(
@@ -135,16 +110,37 @@ static KomeliaOrtInputTensor *create_tensor(
     const size_t tensor_input_ele_count = resize_height * resize_width * 3;
     unsigned char *image_input_data = (unsigned char *)vips_image_get_data(transformed);
 
+    KomeliaTensorNormalization normalization = get_normalization();
     size_t tensor_data_len;
     void *tensor_data;
     if (data_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
         tensor_data_len = tensor_input_ele_count * sizeof(float);
         tensor_data = malloc(tensor_data_len);
-        hwc_to_chw(image_input_data, resize_height, resize_width, tensor_data);
+        komelia_rgb_to_tensor(
+            image_input_data,
+            (size_t)resize_width * 3,
+            resize_width,
+            resize_height,
+            resize_width,
+            resize_height,
+            &normalization,
+            tensor_data,
+            true
+        );
     } else {
         tensor_data_len = tensor_input_ele_count * sizeof(_Float16);
         tensor_data = malloc(tensor_data_len);
-        hwc_to_chw_f16(image_input_data, resize_height, resize_width, tensor_data);
+        komelia_rgb_to_tensor_f16(
+            image_input_data,
+            (size_t)resize_width * 3,
+            resize_width,
+            resize_height,
+            resize_width,
+            resize_height,
+            &normalization,
+            tensor_data,
+            true
+        );
     }
     g_object_unref(transformed);
 
@@ -162,6 +158,7 @@ KomeliaRfDetr *komelia_ort_rfdetr_create(KomeliaOrt *ort) {
     rf_detr->device_id = 0;
     rf_detr->model_path = nullptr;
     rf_detr->session = nullptr;
+    rf_detr->threads = (KomeliaOrtThreadConfig){0, 0};
     pthread_mutex_init(&rf_detr->mutex, nullptr);
     return rf_detr;
 }
@@ -216,6 +213,24 @@ void komelia_ort_rfdetr_set_execution_provider(
     pthread_mutex_unlock(&rf_detr->mutex);
 }
 
+void komelia_ort_rfdetr_set_thread_count(
+    KomeliaRfDetr *rf_detr,
+    int intra_op_threads,
+    int inter_op_threads
+) {
+    pthread_mutex_lock(&rf_detr->mutex);
+    if (rf_detr->threads.intra_op_threads != intra_op_threads ||
+        rf_detr->threads.inter_op_threads != inter_op_threads) {
+        rf_detr->threads.intra_op_threads = intra_op_threads;
+        rf_detr->threads.inter_op_threads = inter_op_threads;
+        if (rf_detr->session != nullptr) {
+            komelia_ort_close_session(rf_detr->komelia_ort, rf_detr->session);
+            rf_detr->session = nullptr;
+        }
+    }
+    pthread_mutex_unlock(&rf_detr->mutex);
+}
+
 static void sigmoid(
     const float *input,
     size_t input_len,
@@ -473,10 +488,13 @@ KomeliaRfDetrResults *komelia_ort_rfdetr(
             rf_detr->execution_provider,
             rf_detr->device_id,
             rf_detr->model_path,
+            rf_detr->threads,
+            0,
             &session_init_error
         );
         if (session_init_error != nullptr) {
             g_propagate_error(error, session_init_error);
+            pthread_mutex_unlock(&rf_detr->mutex);
             return nullptr;
         }
         rf_detr->session = session;
@@ -514,6 +532,7 @@ KomeliaRfDetrResults *komelia_ort_rfdetr(
     const int input_tensor_width = (int)tensor_shape[tensor_shape_len - 1];
     const int input_tensor_height = (int)tensor_shape[tensor_shape_len - 2];
 
+    int64_t stage_start = komelia_stage_start();
     GError *input_tensor_error = nullptr;
     KomeliaOrtInputTensor *input_tensor = create_tensor(
         image,
@@ -522,12 +541,14 @@ KomeliaRfDetrResults *komelia_ort_rfdetr(
         session->input_data_type,
         &input_tensor_error
     );
+    komelia_stage_end(KOMELIA_STAGE_RF_DETR_PREPROCESS, stage_start);
     if (input_tensor_error != nullptr) {
         g_propagate_error(error, input_tensor_error);
         pthread_mutex_unlock(&rf_detr->mutex);
         return nullptr;
     }
 
+    stage_start = komelia_stage_start();
     GError *inference_error = nullptr;
     InferenceResult *inference_result = komelia_ort_run_inference(
         rf_detr->komelia_ort,
@@ -535,6 +556,7 @@ KomeliaRfDetrResults *komelia_ort_rfdetr(
         input_tensor,
         &inference_error
     );
+    komelia_stage_end(KOMELIA_STAGE_RF_DETR_RUN, stage_start);
     free(input_tensor->data);
     free(input_tensor->shape);
     free(input_tensor);
@@ -545,6 +567,7 @@ KomeliaRfDetrResults *komelia_ort_rfdetr(
         return nullptr;
     }
 
+    stage_start = komelia_stage_start();
     GError *detect_error = nullptr;
     KomeliaRfDetrResults *detect_result = get_results_from_tensor(
         rf_detr,
@@ -553,8 +576,10 @@ KomeliaRfDetrResults *komelia_ort_rfdetr(
         input_height,
         &detect_error
     );
+    komelia_stage_end(KOMELIA_STAGE_RF_DETR_POSTPROCESS, stage_start);
     if (detect_error != nullptr) {
         g_propagate_error(error, detect_error);
+        komelia_ort_release_inference_result(rf_detr->komelia_ort, inference_result);
         pthread_mutex_unlock(&rf_detr->mutex);
         return nullptr;
     }
@@ -11,6 +11,7 @@ typedef struct {
     int device_id;
     char *model_path;
     SessionData *session;
+    KomeliaOrtThreadConfig threads;
     pthread_mutex_t mutex;
 } KomeliaRfDetr;
 
@@ -40,6 +41,12 @@ void komelia_ort_rfdetr_set_execution_provider(
     int device_id
 );
 
+void komelia_ort_rfdetr_set_thread_count(
+    KomeliaRfDetr *rf_detr,
+    int intra_op_threads,
+    int inter_op_threads
+);
+
 KomeliaRfDetrResults *komelia_ort_rfdetr(
     KomeliaRfDetr *rf_detr,
     VipsImage *image,
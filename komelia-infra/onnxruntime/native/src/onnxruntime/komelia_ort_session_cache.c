@@ -0,0 +1,284 @@
+#include "komelia_ort_session_cache.h"
+
+#include <glib/gstdio.h>
+
+static int default_max_sessions = 4;
+static size_t default_memory_limit = (size_t)1024 * 1024 * 1024;
+// activation estimate for sessions without tiling
+static int untiled_size_estimate = 1024;
+// upscale factor is not known before the first run
+static size_t activation_scale_estimate = 4;
+// intermediate feature maps are several times larger than float output tensor
+static size_t activation_factor = 8;
+
+typedef struct {
+    char *model_path;
+    KomeliaOrtExecutionProvider execution_provider;
+    int device_id;
+    int tile_size;
+    KomeliaOrtThreadConfig threads;
+
+    // nullptr while session is being created
+    SessionData *session;
+    size_t memory_estimate;
+    int users;
+} CacheEntry;
+
+struct KomeliaOrtSessionCache {
+    KomeliaOrt *komelia_ort;
+    // most recently used entries first
+    GQueue entries;
+    GMutex lock;
+    GCond session_created;
+    GThreadPool *warm_up_pool;
+    int max_sessions;
+    size_t memory_limit;
+};
+
+// weights are loaded once, but arena of an upscale model is dominated by activations of a tile batch.
+// For a 512px tile 4x output with batch of 4 activations are over a gigabyte while weights are tens of megabytes
+static size_t estimate_session_memory(const KomeliaOrtSessionKey *key) {
+    size_t weights = 0;
+    GStatBuf model_stat;
+    if (g_stat(key->model_path, &model_stat) == 0)
+        weights = (size_t)model_stat.st_size;
+
+    size_t tile_size = key->tile_size > 0 ? key->tile_size : untiled_size_estimate;
+    size_t batch_size = key->batch_size > 0 ? key->batch_size : 1;
+    size_t output_tensor = tile_size * tile_size * 3 * sizeof(float) *
+                           activation_scale_estimate * activation_scale_estimate;
+    return weights + output_tensor * batch_size * activation_factor;
+}
+
+static CacheEntry *new_entry(const KomeliaOrtSessionKey *key) {
+    CacheEntry *entry = malloc(sizeof(CacheEntry));
+    entry->model_path = strdup(key->model_path);
+    entry->execution_provider = key->execution_provider;
+    entry->device_id = key->device_id;
+    entry->tile_size = key->tile_size;
+    entry->threads = key->threads;
+    entry->session = nullptr;
+    entry->memory_estimate = estimate_session_memory(key);
+    entry->users = 0;
+    return entry;
+}
+
+static void free_entry(
+    KomeliaOrtSessionCache *cache,
+    CacheEntry *entry
+) {
+    if (entry->session != nullptr) {
+        komelia_ort_close_session(cache->komelia_ort, entry->session);
+    }
+    free(entry->model_path);
+    free(entry);
+}
+
+static bool entry_matches(
+    const CacheEntry *entry,
+    const KomeliaOrtSessionKey *key
+) {
+    return entry->execution_provider == key->execution_provider &&
+           entry->device_id == key->device_id &&
+           entry->tile_size == key->tile_size &&
+           entry->threads.intra_op_threads == key->threads.intra_op_threads &&
+           entry->threads.inter_op_threads == key->threads.inter_op_threads &&
+           strcmp(entry->model_path, key->model_path) == 0;
+}
+
+static CacheEntry *find_entry(
+    KomeliaOrtSessionCache *cache,
+    const KomeliaOrtSessionKey *key
+) {
+    for (GList *link = cache->entries.head; link != nullptr; link = link->next) {
+        CacheEntry *entry = link->data;
+        if (entry_matches(entry, key))
+            return entry;
+    }
+    return nullptr;
+}
+
+// closes least recently used sessions that are not in use until cache fits into limits.
+// Must be called with cache lock held
+static void evict_sessions(KomeliaOrtSessionCache *cache) {
+    int session_count = (int)cache->entries.length;
+    size_t memory = 0;
+    for (GList *link = cache->entries.head; link != nullptr; link = link->next) {
+        CacheEntry *entry = link->data;
+        memory += entry->memory_estimate;
+    }
+
+    GList *link = cache->entries.tail;
+    while (link != nullptr && (session_count > cache->max_sessions || memory > cache->memory_limit)) {
+        GList *previous = link->prev;
+        CacheEntry *entry = link->data;
+        if (entry->users == 0 && entry->session != nullptr) {
+            --session_count;
+            memory -= entry->memory_estimate;
+            g_queue_delete_link(&cache->entries, link);
+            free_entry(cache, entry);
+        }
+        link = previous;
+    }
+}
+
+// entry is not evicted while session is being created.
+// On failure entry is removed from cache and must not be used by the caller
+static SessionData *create_entry_session(
+    KomeliaOrtSessionCache *cache,
+    CacheEntry *entry,
+    GError **error
+) {
+    // session is never limited below its own estimate
+    g_mutex_lock(&cache->lock);
+    size_t gpu_mem_limit = MAX(cache->memory_limit, entry->memory_estimate);
+    g_mutex_unlock(&cache->lock);
+
+    GError *session_error = nullptr;
+    SessionData *session = komelia_ort_create_session(
+        cache->komelia_ort,
+        entry->execution_provider,
+        entry->device_id,
+        entry->model_path,
+        entry->threads,
+        gpu_mem_limit,
+        &session_error
+    );
+
+    g_mutex_lock(&cache->lock);
+    if (session_error != nullptr) {
+        g_queue_remove(&cache->entries, entry);
+        free_entry(cache, entry);
+        g_propagate_error(error, session_error);
+        session = nullptr;
+    } else {
+        entry->session = session;
+        evict_sessions(cache);
+    }
+    g_cond_broadcast(&cache->session_created);
+    g_mutex_unlock(&cache->lock);
+    return session;
+}
+
+static void run_warm_up(
+    gpointer data,
+    gpointer user_data
+) {
+    // warm-up errors are discarded. Session creation is retried and reported on acquire
+    create_entry_session(user_data, data, nullptr);
+}
+
+KomeliaOrtSessionCache *komelia_ort_session_cache_create(KomeliaOrt *komelia_ort) {
+    KomeliaOrtSessionCache *cache = malloc(sizeof(KomeliaOrtSessionCache));
+    cache->komelia_ort = komelia_ort;
+    g_queue_init(&cache->entries);
+    g_mutex_init(&cache->lock);
+    g_cond_init(&cache->session_created);
+    // sessions are warmed up one at a time to limit memory spikes during session creation
+    cache->warm_up_pool = g_thread_pool_new(run_warm_up, cache, 1, FALSE, nullptr);
+    cache->max_sessions = default_max_sessions;
+    cache->memory_limit = default_memory_limit;
+    return cache;
+}
+
+void komelia_ort_session_cache_destroy(KomeliaOrtSessionCache *cache) {
+    // queued warm-ups are dropped, entries are freed below
+    g_thread_pool_free(cache->warm_up_pool, TRUE, TRUE);
+
+    CacheEntry *entry;
+    while ((entry = g_queue_pop_head(&cache->entries)) != nullptr) {
+        free_entry(cache, entry);
+    }
+    g_mutex_clear(&cache->lock);
+    g_cond_clear(&cache->session_created);
+    free(cache);
+}
+
+void komelia_ort_session_cache_set_limits(
+    KomeliaOrtSessionCache *cache,
+    int max_sessions,
+    size_t memory_limit
+) {
+    g_mutex_lock(&cache->lock);
+    cache->max_sessions = max_sessions;
+    cache->memory_limit = memory_limit;
+    evict_sessions(cache);
+    g_mutex_unlock(&cache->lock);
+}
+
+SessionData *komelia_ort_session_cache_acquire(
+    KomeliaOrtSessionCache *cache,
+    const KomeliaOrtSessionKey *key,
+    GError **error
+) {
+    g_mutex_lock(&cache->lock);
+    CacheEntry *entry = find_entry(cache, key);
+    while (entry != nullptr && entry->session == nullptr) {
+        // don't wait for other queued warm-ups
+        g_thread_pool_move_to_front(cache->warm_up_pool, entry);
+        g_cond_wait(&cache->session_created, &cache->lock);
+        entry = find_entry(cache, key);
+    }
+
+    if (entry != nullptr) {
+        ++entry->users;
+        g_queue_remove(&cache->entries, entry);
+        g_queue_push_head(&cache->entries, entry);
+        g_mutex_unlock(&cache->lock);
+        return entry->session;
+    }
+
+    entry = new_entry(key);
+    entry->users = 1;
+    g_queue_push_head(&cache->entries, entry);
+    g_mutex_unlock(&cache->lock);
+
+    return create_entry_session(cache, entry, error);
+}
+
+void komelia_ort_session_cache_release(
+    KomeliaOrtSessionCache *cache,
+    SessionData *session
+) {
+    g_mutex_lock(&cache->lock);
+    for (GList *link = cache->entries.head; link != nullptr; link = link->next) {
+        CacheEntry *entry = link->data;
+        if (entry->session == session) {
+            --entry->users;
+            break;
+        }
+    }
+    evict_sessions(cache);
+    g_mutex_unlock(&cache->lock);
+}
+
+void komelia_ort_session_cache_warm_up(
+    KomeliaOrtSessionCache *cache,
+    const KomeliaOrtSessionKey *key
+) {
+    g_mutex_lock(&cache->lock);
+    if (find_entry(cache, key) != nullptr) {
+        g_mutex_unlock(&cache->lock);
+        return;
+    }
+    CacheEntry *entry = new_entry(key);
+    g_queue_push_head(&cache->entries, entry);
+    g_mutex_unlock(&cache->lock);
+
+    g_thread_pool_push(cache->warm_up_pool, entry, nullptr);
+}
+
+void komelia_ort_session_cache_clear(KomeliaOrtSessionCache *cache) {
+    g_mutex_lock(&cache->lock);
+    GList *link = cache->entries.head;
+    while (link != nullptr) {
+        GList *next = link->next;
+        CacheEntry *entry = link->data;
+        if (entry->users == 0 && entry->session != nullptr) {
+            g_queue_delete_link(&cache->entries, link);
+            free_entry(cache, entry);
+        }
+        link = next;
+    }
+    g_mutex_unlock(&cache->lock);
+}
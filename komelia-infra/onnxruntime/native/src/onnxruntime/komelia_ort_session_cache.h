@@ -0,0 +1,57 @@
+#ifndef KOMELIA_ORT_SESSION_CACHE_H
+#define KOMELIA_ORT_SESSION_CACHE_H
+
+#include "komelia_onnxruntime.h"
+
+// Least recently used sessions are kept open after model or provider switch.
+// Sessions that are not in use are closed when cache exceeds session count or memory limit
+typedef struct KomeliaOrtSessionCache KomeliaOrtSessionCache;
+
+typedef struct {
+    const char *model_path;
+    KomeliaOrtExecutionProvider execution_provider;
+    int device_id;
+    // providers that build engines for fixed input shapes create separate session for each tile size
+    int tile_size;
+    KomeliaOrtThreadConfig threads;
+    // tiles inferred in a single run. Only used for memory estimate, sessions are shared between batch sizes
+    int batch_size;
+} KomeliaOrtSessionKey;
+
+KomeliaOrtSessionCache *komelia_ort_session_cache_create(KomeliaOrt *komelia_ort);
+
+// waits for running warm-up and closes all sessions. Acquired sessions must be released before destroy
+void komelia_ort_session_cache_destroy(KomeliaOrtSessionCache *cache);
+
+// memory limit is compared against estimated session size.
+// Size is estimated from model file size and activation memory of a tile batch.
+// Device memory arena of a single session is also capped by memory limit
+void komelia_ort_session_cache_set_limits(
+    KomeliaOrtSessionCache *cache,
+    int max_sessions,
+    size_t memory_limit
+);
+
+// returns cached session or creates new one. Waits for session that is being warmed up.
+// Session is not closed until it's released
+SessionData *komelia_ort_session_cache_acquire(
+    KomeliaOrtSessionCache *cache,
+    const KomeliaOrtSessionKey *key,
+    GError **error
+);
+
+void komelia_ort_session_cache_release(
+    KomeliaOrtSessionCache *cache,
+    SessionData *session
+);
+
+// creates session in background. Does nothing if session is already cached or being created
+void komelia_ort_session_cache_warm_up(
+    KomeliaOrtSessionCache *cache,
+    const KomeliaOrtSessionKey *key
+);
+
+// closes all sessions that are not in use
+void komelia_ort_session_cache_clear(KomeliaOrtSessionCache *cache);
+
+#endif // KOMELIA_ORT_SESSION_CACHE_H
@@ -1,9 +1,17 @@
 #include "komelia_ort_upscaler.h"
 
 #include "komelia_error.h"
-#include "komelia_matrix_ops.h"
+#include "komelia_common_types.h"
+#include "komelia_tensor_conversions.h"
+#include "komelia_stage_stats.h"
 
 static int tile_threshold = 512 * 512;
+// used to estimate batch output tensor size before the first run
+static size_t batch_output_scale_estimate = 4;
+// used by region upscale if tiling is disabled
+static int region_tile_size = 512;
+// rings of tiles around the requested region kept in region upscale tile cache
+static int tile_cache_neighbourhood = 1;
 
 static void copy_animation_metadata(
     VipsImage *input,
@@ -25,35 +33,41 @@ static void copy_animation_metadata(
     }
 }
 
-static void hwc_to_chw(
-    const uint8_t *input,
-    size_t height,
-    size_t width,
-    size_t channels,
-    float *output
-) {
-    size_t stride_size = height * width;
-#pragma omp parallel for shared(stride_size, channels, input, output) default(none) collapse(2)
-    for (size_t i = 0; i != stride_size; ++i) {
-        for (size_t c = 0; c != channels; ++c) {
-            output[c * stride_size + i] = (float)input[i * channels + c] / 255.0f;
-        }
-    }
-}
-
-static void hwc_to_chw_f16(
+static void write_tensor_data(
+    ONNXTensorElementDataType data_type,
     const uint8_t *input,
-    size_t height,
-    size_t width,
-    size_t channels,
-    _Float16 *output
-) {
-    size_t stride_size = height * width;
-#pragma omp parallel for shared(stride_size, channels, input, output) default(none) collapse(2)
-    for (size_t i = 0; i != stride_size; ++i) {
-        for (size_t c = 0; c != channels; ++c) {
-            output[c * stride_size + i] = (_Float16)input[i * channels + c] / 255.0f16;
-        }
+    size_t input_stride,
+    int input_width,
+    int input_height,
+    int tensor_width,
+    int tensor_height,
+    void *tensor_data,
+    bool parallel
+) {
+    if (data_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
+        komelia_rgb_to_tensor(
+            input,
+            input_stride,
+            input_width,
+            input_height,
+            tensor_width,
+            tensor_height,
+            &komelia_unit_normalization,
+            tensor_data,
+            parallel
+        );
+    } else {
+        komelia_rgb_to_tensor_f16(
+            input,
+            input_stride,
+            input_width,
+            input_height,
+            tensor_width,
+            tensor_height,
+            &komelia_unit_normalization,
+            tensor_data,
+            parallel
+        );
     }
 }
 
@@ -75,16 +89,24 @@ static KomeliaOrtInputTensor *create_tensor(
     unsigned char *image_input_data = (unsigned char *)vips_image_get_data(input_image);
 
     size_t tensor_data_len;
-    void *tensor_data;
     if (data_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
         tensor_data_len = tensor_input_ele_count * sizeof(float);
-        tensor_data = malloc(tensor_data_len);
-        hwc_to_chw(image_input_data, input_height, input_width, 3, tensor_data);
     } else {
         tensor_data_len = tensor_input_ele_count * sizeof(_Float16);
-        tensor_data = malloc(tensor_data_len);
-        hwc_to_chw_f16(image_input_data, input_height, input_width, 3, tensor_data);
     }
+    void *tensor_data = malloc(tensor_data_len);
+    write_tensor_data(
+        data_type,
+        image_input_data,
+        (size_t)input_width * 3,
+        input_width,
+        input_height,
+        input_width,
+        input_height,
+        tensor_data,
+        true
+    );
+
     tensor->data = tensor_data;
     tensor->data_len = tensor_data_len;
     tensor->shape = tensor_shape;
@@ -161,14 +183,30 @@ static VipsImage *get_image_from_tensor(
 
     uint8_t *output_image_data = malloc(output_size);
     if (output_element_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
-        komelia_chw_to_hwc(output_tensor_data, output_height, output_width, 3, output_image_data);
+        komelia_tensor_to_rgb(
+            output_tensor_data,
+            output_width,
+            output_height,
+            0,
+            0,
+            output_width,
+            output_height,
+            output_image_data,
+            (size_t)output_width * 3,
+            true
+        );
     } else {
-        komelia_chw_to_hwc_f16(
+        komelia_tensor_to_rgb_f16(
             output_tensor_data,
+            output_width,
             output_height,
+            0,
+            0,
             output_width,
-            3,
-            output_image_data
+            output_height,
+            output_image_data,
+            (size_t)output_width * 3,
+            true
         );
     }
 
@@ -191,206 +229,795 @@ static VipsImage *get_image_from_tensor(
     return inferred_image;
 }
 
-static VipsImage *upscale_tile(
+// tile buffers are reused by all images as long as tile tensor shape stays the same.
+// Batch dimension is fixed per session, incomplete batches are padded
+static KomeliaOrtIoBuffers *get_tile_buffers(
     KomeliaOrtUpscaler *upscaler,
-    VipsImage *input_image,
-    VipsRect *region_rect,
+    KomeliaOrtIoBuffers **cached_buffers,
+    int batch_size,
+    int tensor_width,
+    int tensor_height,
     GError **error
 ) {
+    KomeliaOrtIoBuffers *buffers = *cached_buffers;
+    if (buffers != nullptr && buffers->input_shape[0] == batch_size &&
+        buffers->input_shape[2] == tensor_height && buffers->input_shape[3] == tensor_width) {
+        return buffers;
+    }
+
+    komelia_ort_release_io_buffers(upscaler->komelia_ort, buffers);
+    *cached_buffers = nullptr;
 
-    int image_bands = vips_image_get_bands(input_image);
-    VipsRegion *region = vips_region_new(input_image);
+    int64_t tensor_shape[4] = {batch_size, 3, tensor_height, tensor_width};
+    GError *buffers_error = nullptr;
+    buffers = komelia_ort_create_io_buffers(
+        upscaler->komelia_ort,
+        upscaler->session,
+        tensor_shape,
+        4,
+        &buffers_error
+    );
+    if (buffers_error != nullptr) {
+        g_propagate_error(error, buffers_error);
+        return nullptr;
+    }
+    *cached_buffers = buffers;
+    return buffers;
+}
+
+static void release_tile_buffers(KomeliaOrtUpscaler *upscaler) {
+    for (int i = 0; i < KOMELIA_UPSCALER_PIPELINE_DEPTH; ++i) {
+        komelia_ort_release_io_buffers(upscaler->komelia_ort, upscaler->tile_buffers[i]);
+        upscaler->tile_buffers[i] = nullptr;
+    }
+}
+
+// number of tiles inferred in a single run. Limited by model input, configured max batch size
+// and memory limit for input and output tensors of all batches in the pipeline.
+// Doesn't depend on tile count so that every run uses the same tensor shape.
+// Changing shape reallocates io buffers and makes TensorRT rebuild its engine
+static int get_batch_size(
+    KomeliaOrtUpscaler *upscaler,
+    int tile_width,
+    int tile_height
+) {
+    if (!upscaler->session->dynamic_batch || upscaler->max_batch_size <= 1)
+        return 1;
+
+    size_t element_size = upscaler->session->input_data_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16
+                              ? sizeof(_Float16)
+                              : sizeof(float);
+    size_t tile_input_size = (size_t)tile_width * tile_height * 3 * element_size;
+    size_t tile_memory = tile_input_size + tile_input_size * batch_output_scale_estimate *
+                                               batch_output_scale_estimate;
+    size_t batch_memory_limit = upscaler->batch_memory_limit / KOMELIA_UPSCALER_PIPELINE_DEPTH;
+    int memory_batch_size = (int)(batch_memory_limit / tile_memory);
+
+    int max_batch_size = min(upscaler->max_batch_size, KOMELIA_UPSCALER_MAX_BATCH_SIZE);
+    return max(1, min(max_batch_size, memory_batch_size));
+}
+
+// session stays in cache and is reused on the next switch back to the same model and provider
+static void release_session(KomeliaOrtUpscaler *upscaler) {
+    release_tile_buffers(upscaler);
+    if (upscaler->session != nullptr) {
+        komelia_ort_session_cache_release(upscaler->session_cache, upscaler->session);
+        upscaler->session = nullptr;
+    }
+}
+
+static KomeliaOrtSessionKey get_session_key(
+    KomeliaOrtUpscaler *upscaler,
+    const char *model_path
+) {
+    KomeliaOrtSessionKey key;
+    key.model_path = model_path;
+    key.execution_provider = upscaler->execution_provider;
+    key.device_id = upscaler->device_id;
+    key.tile_size = upscaler->tile_size;
+    key.threads = upscaler->threads;
+    key.batch_size = upscaler->max_batch_size;
+    return key;
+}
+
+// writes image region to the tensor batch slot directly from prepared region pixels.
+// Region is reused between tiles, vips clips prepared area to the image bounds
+static void write_tile_input(
+    KomeliaOrtUpscaler *upscaler,
+    KomeliaOrtIoBuffers *buffers,
+    int batch_slot,
+    VipsRegion *region,
+    VipsRect *region_rect,
+    GError **error
+) {
+    // tile pixels are computed from the lazy source pipeline here
+    int64_t stage_start = komelia_stage_start();
     int prepare_error = vips_region_prepare(region, region_rect);
+    komelia_stage_end(KOMELIA_STAGE_UPSCALE_TILE_FETCH, stage_start);
     if (prepare_error) {
-        g_object_unref(region);
         g_set_error_literal(error, KOMELIA_ORT_ERROR, KOMELIA_ORT_ERROR_VIPS, vips_error_buffer());
         vips_error_clear();
-        return nullptr;
+        return;
     }
 
-    size_t region_size = 0;
-    VipsPel *region_data = vips_region_fetch(
-        region,
-        region_rect->left,
-        region_rect->top,
-        region_rect->width,
-        region_rect->height,
-        &region_size
+    stage_start = komelia_stage_start();
+    int tensor_width = (int)buffers->input_shape[3];
+    int tensor_height = (int)buffers->input_shape[2];
+    size_t slot_size = buffers->input_data_len / buffers->input_shape[0];
+    write_tensor_data(
+        upscaler->session->input_data_type,
+        VIPS_REGION_ADDR(region, region->valid.left, region->valid.top),
+        VIPS_REGION_LSKIP(region),
+        region->valid.width,
+        region->valid.height,
+        tensor_width,
+        tensor_height,
+        (uint8_t *)buffers->input_data + slot_size * batch_slot,
+        false
     );
-    VipsImage *unformatted_image = vips_image_new_from_memory(
-        region_data,
-        region_size,
-        region_rect->width,
-        region_rect->height,
-        image_bands,
-        VIPS_FORMAT_UCHAR
+    komelia_stage_end(KOMELIA_STAGE_UPSCALE_TENSOR_BUILD, stage_start);
+}
+
+static void get_output_tensor_size(
+    const OrtApi *ort_api,
+    InferenceResult *result,
+    int *width,
+    int *height,
+    GError **error
+) {
+    size_t dim_length;
+    OrtStatus *ort_status = ort_api->GetDimensionsCount(result->out_tensors_info[0], &dim_length);
+    if (ort_status != nullptr) {
+        wrap_ort_error(ort_api, ort_status, KOMELIA_ORT_ERROR_INFERENCE, error);
+        return;
+    }
+    if (dim_length != 4) {
+        g_set_error_literal(
+            error,
+            KOMELIA_ORT_ERROR,
+            KOMELIA_ORT_ERROR_INFERENCE,
+            "Unexpected number of output dimensions"
+        );
+        return;
+    }
+
+    int64_t dim_values[4];
+    ort_status = ort_api->GetDimensions(result->out_tensors_info[0], dim_values, dim_length);
+    if (ort_status != nullptr) {
+        wrap_ort_error(ort_api, ort_status, KOMELIA_ORT_ERROR_INFERENCE, error);
+        return;
+    }
+    *width = (int)dim_values[3];
+    *height = (int)dim_values[2];
+}
+
+static VipsImage *new_output_image(
+    int width,
+    int height,
+    GError **error
+) {
+    VipsImage *image = vips_image_new_memory();
+    vips_image_init_fields(
+        image,
+        width,
+        height,
+        3,
+        VIPS_FORMAT_UCHAR,
+        VIPS_CODING_NONE,
+        VIPS_INTERPRETATION_sRGB,
+        1.0,
+        1.0
     );
-    if (!unformatted_image) {
-        g_object_unref(region);
-        g_free(region_data);
+    if (vips_image_write_prepare(image)) {
+        g_object_unref(image);
         g_set_error_literal(error, KOMELIA_ORT_ERROR, KOMELIA_ORT_ERROR_VIPS, vips_error_buffer());
         vips_error_clear();
         return nullptr;
     }
+    return image;
+}
 
-    VipsImage *formatted_region_image = nullptr;
-    vips_copy(
-        unformatted_image,
-        &formatted_region_image,
-        "bands",
-        vips_image_get_bands(input_image),
-        "format",
-        vips_image_get_format(input_image),
-        "coding",
-        vips_image_get_coding(input_image),
-        "interpretation",
-        vips_image_get_interpretation(input_image),
-        nullptr
-    );
-
-    if (!formatted_region_image) {
-        g_object_unref(region);
-        g_object_unref(unformatted_image);
-        g_free(region_data);
+// lines are appended to the file with vips_image_write_line in top to bottom order.
+// Temporary file is used if path is not set
+static VipsImage *new_disk_output_image(
+    int width,
+    int height,
+    const char *path,
+    GError **error
+) {
+    VipsImage *image = path != nullptr
+                           ? vips_image_new_from_file_mode(path, "w")
+                           : vips_image_new_temp_file("%s.v");
+    if (image == nullptr) {
         g_set_error_literal(error, KOMELIA_ORT_ERROR, KOMELIA_ORT_ERROR_VIPS, vips_error_buffer());
         vips_error_clear();
         return nullptr;
     }
-
-    KomeliaOrtInputTensor *input_tensor =
-        create_tensor(upscaler->session->input_data_type, formatted_region_image);
-    GError *inference_error = nullptr;
-    InferenceResult *inference_result = komelia_ort_run_inference(
-        upscaler->komelia_ort,
-        upscaler->session,
-        input_tensor,
-        &inference_error
+    vips_image_init_fields(
+        image,
+        width,
+        height,
+        3,
+        VIPS_FORMAT_UCHAR,
+        VIPS_CODING_NONE,
+        VIPS_INTERPRETATION_sRGB,
+        1.0,
+        1.0
     );
-    free(input_tensor->data);
-    free(input_tensor->shape);
-    free(input_tensor);
+    return image;
+}
 
-    if (inference_error != nullptr) {
-        g_object_unref(region);
-        g_object_unref(unformatted_image);
-        g_object_unref(formatted_region_image);
-        g_free(region_data);
-        g_propagate_error(error, inference_error);
-        return nullptr;
+static void write_tile_output(
+    const OrtApi *ort_api,
+    InferenceResult *result,
+    int batch_slot,
+    int tensor_width,
+    int tensor_height,
+    int tensor_left,
+    int tensor_top,
+    VipsImage *output,
+    const VipsRect *output_rect,
+    GError **error
+) {
+    void *output_tensor_data = nullptr;
+    OrtStatus *ort_status = ort_api->GetTensorMutableData(result->output_tensors[0], &output_tensor_data);
+    if (ort_status != nullptr) {
+        wrap_ort_error(ort_api, ort_status, KOMELIA_ORT_ERROR_INFERENCE, error);
+        return;
     }
 
-    GError *image_tensor_error = nullptr;
-    VipsImage *upscaled_image =
-        get_image_from_tensor(upscaler, inference_result, &image_tensor_error);
+    ONNXTensorElementDataType output_element_type;
+    ort_status = ort_api->GetTensorElementType(result->out_tensors_info[0], &output_element_type);
+    if (ort_status != nullptr) {
+        wrap_ort_error(ort_api, ort_status, KOMELIA_ORT_ERROR_INFERENCE, error);
+        return;
+    }
 
-    if (image_tensor_error != nullptr) {
-        g_propagate_error(error, image_tensor_error);
+    size_t slot_offset = (size_t)batch_slot * 3 * tensor_width * tensor_height;
+    VipsPel *output_pixels = VIPS_IMAGE_ADDR(output, output_rect->left, output_rect->top);
+    size_t output_stride = VIPS_IMAGE_SIZEOF_LINE(output);
+    if (output_element_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT) {
+        const float *tile_data = (const float *)output_tensor_data + slot_offset;
+        komelia_tensor_to_rgb(
+            tile_data,
+            tensor_width,
+            tensor_height,
+            tensor_left,
+            tensor_top,
+            output_rect->width,
+            output_rect->height,
+            output_pixels,
+            output_stride,
+            false
+        );
+    } else {
+        const _Float16 *tile_data = (const _Float16 *)output_tensor_data + slot_offset;
+        komelia_tensor_to_rgb_f16(
+            tile_data,
+            tensor_width,
+            tensor_height,
+            tensor_left,
+            tensor_top,
+            output_rect->width,
+            output_rect->height,
+            output_pixels,
+            output_stride,
+            false
+        );
     }
-    g_object_unref(region);
-    g_object_unref(unformatted_image);
-    g_object_unref(formatted_region_image);
-    g_free(region_data);
-    komelia_ort_release_inference_result(upscaler->komelia_ort, inference_result);
+}
 
-    return upscaled_image;
+// Tile position along one image axis.
+// Tensor area includes overlap with neighbouring tiles, only the core area is written to the output
+typedef struct {
+    int tensor_start;
+    int core_start;
+    int core_size;
+} TileSpan;
+
+static int get_tile_count(
+    int image_size,
+    int tensor_size,
+    int overlap
+) {
+    if (tensor_size >= image_size)
+        return 1;
+    int core_step = tensor_size - 2 * overlap;
+    return (image_size + core_step - 1) / core_step;
 }
 
-static VipsImage *do_tiled_inference(
-    KomeliaOrtUpscaler *upscaler,
-    VipsImage *input_image,
+static TileSpan get_tile_span(
+    int tile_index,
+    int image_size,
+    int tensor_size,
+    int overlap
+) {
+    TileSpan span;
+    if (tensor_size >= image_size) {
+        span.tensor_start = 0;
+        span.core_start = 0;
+        span.core_size = image_size;
+        return span;
+    }
+
+    int core_step = tensor_size - 2 * overlap;
+    span.core_start = tile_index * core_step;
+    span.core_size = min(core_step, image_size - span.core_start);
+    // tiles at image edges are shifted inward to keep tensor area inside the image
+    span.tensor_start = max(0, min(span.core_start - overlap, image_size - tensor_size));
+    return span;
+}
+
+typedef struct {
+    int image_width;
+    int image_height;
+    int tile_width;
+    int tile_height;
+    int overlap;
+    int row_tiles;
+    int tile_count;
+    int batch_size;
+    int batch_count;
+} TileGrid;
+
+typedef struct {
+    KomeliaOrtIoBuffers *buffers;
+    int batch_start;
+    int batch_tiles;
+    TileSpan column_spans[KOMELIA_UPSCALER_MAX_BATCH_SIZE];
+    TileSpan row_spans[KOMELIA_UPSCALER_MAX_BATCH_SIZE];
+    InferenceResult *result;
+    GError *error;
+} TileBatch;
+
+// Batches move between stages through queues:
+// free -> preprocessing thread -> ready -> inference on calling thread -> done -> postprocessing thread -> free.
+// Number of batches in the pipeline is bounded by the number of tile buffers
+typedef struct {
+    KomeliaOrtUpscaler *upscaler;
+    VipsImage *input_image;
+    // vips file written by the pipeline. Temporary file or memory is used if not set
+    const char *output_path;
+    TileGrid grid;
+    // indices of grid tiles processed by the pipeline. All tiles are processed if not set
+    const int *tile_indices;
+    TileBatch batches[KOMELIA_UPSCALER_PIPELINE_DEPTH];
+    // passed through queues to stop worker threads
+    TileBatch stop;
+
+    GAsyncQueue *free_batches;
+    GAsyncQueue *ready_batches;
+    GAsyncQueue *done_batches;
+    gint cancelled;
+
+    // set by inference stage before the first batch is passed to postprocessing
+    VipsImage *output_image;
+    // with disk output, tile row is assembled in memory before it's appended to output image
+    VipsImage *output_strip;
+    int strip_top;
+    // if set, each tile is written to separate image stored at its grid index instead of output image
+    VipsImage **tile_images;
+    int scale;
+    int output_tile_width;
+    int output_tile_height;
+    GError *postprocess_error;
+} TilePipeline;
+
+static int get_grid_tile_index(
+    const TilePipeline *pipeline,
+    int pipeline_tile
+) {
+    return pipeline->tile_indices != nullptr ? pipeline->tile_indices[pipeline_tile] : pipeline_tile;
+}
+
+static void preprocess_batch(
+    TilePipeline *pipeline,
+    VipsRegion *region,
+    TileBatch *batch,
+    int batch_index
+) {
+    const TileGrid *grid = &pipeline->grid;
+    batch->batch_start = batch_index * grid->batch_size;
+    batch->batch_tiles = min(grid->batch_size, grid->tile_count - batch->batch_start);
+    batch->result = nullptr;
+    batch->error = nullptr;
+
+    for (int slot = 0; slot < batch->batch_tiles; ++slot) {
+        int tile_index = get_grid_tile_index(pipeline, batch->batch_start + slot);
+        batch->column_spans[slot] = get_tile_span(
+            tile_index % grid->row_tiles,
+            grid->image_width,
+            grid->tile_width,
+            grid->overlap
+        );
+        batch->row_spans[slot] = get_tile_span(
+            tile_index / grid->row_tiles,
+            grid->image_height,
+            grid->tile_height,
+            grid->overlap
+        );
+
+        VipsRect region_rect;
+        region_rect.left = batch->column_spans[slot].tensor_start;
+        region_rect.top = batch->row_spans[slot].tensor_start;
+        region_rect.width = grid->tile_width;
+        region_rect.height = grid->tile_height;
+        write_tile_input(
+            pipeline->upscaler,
+            batch->buffers,
+            slot,
+            region,
+            &region_rect,
+            &batch->error
+        );
+        if (batch->error != nullptr)
+            return;
+    }
+
+    // unused slots of the last batch are inferred but their output is ignored.
+    // Zeroed input avoids stale or uninitialized values in padded slots
+    int batch_size = (int)batch->buffers->input_shape[0];
+    if (batch->batch_tiles < batch_size) {
+        size_t slot_size = batch->buffers->input_data_len / batch_size;
+        memset(
+            (uint8_t *)batch->buffers->input_data + slot_size * batch->batch_tiles,
+            0,
+            slot_size * (batch_size - batch->batch_tiles)
+        );
+    }
+}
+
+static gpointer run_preprocessing(gpointer data) {
+    TilePipeline *pipeline = data;
+    const TileGrid *grid = &pipeline->grid;
+    VipsRegion *region = vips_region_new(pipeline->input_image);
+
+    for (int batch_index = 0; batch_index < grid->batch_count; ++batch_index) {
+        TileBatch *batch = g_async_queue_pop(pipeline->free_batches);
+        if (batch == &pipeline->stop || g_atomic_int_get(&pipeline->cancelled)) {
+            // unblocks inference stage waiting for the next batch
+            g_async_queue_push(pipeline->ready_batches, &pipeline->stop);
+            break;
+        }
+
+        preprocess_batch(pipeline, region, batch, batch_index);
+        g_async_queue_push(pipeline->ready_batches, batch);
+        if (batch->error != nullptr)
+            break;
+    }
+
+    g_object_unref(region);
+    vips_thread_shutdown();
+    return nullptr;
+}
+
+// appends completed tile row to the output file
+static void write_output_strip(
+    TilePipeline *pipeline,
+    int strip_height,
     GError **error
 ) {
-    int tile_size = upscaler->tile_size;
-    int image_width = vips_image_get_width(input_image);
-    int image_height = vips_image_get_height(input_image);
-
-    int row_tiles = ceil((double)image_width / tile_size);
-    int column_tiles = ceil((double)image_height / tile_size);
-
-    int tile_count = 0;
-    VipsImage *upscaled_tiles[row_tiles * column_tiles];
-
-    int y_taken = 0;
-    while (y_taken != image_height) {
-        int x_taken = 0;
-        int tile_height = y_taken + tile_size < image_height ? tile_size : image_height - y_taken;
-        while (x_taken != image_width) {
-            GError *tile_upscale_error = nullptr;
-
-            VipsRect region_rect;
-            region_rect.top = y_taken;
-            region_rect.left = x_taken;
-            region_rect.height = tile_height;
-            region_rect.width =
-                x_taken + tile_size < image_width ? tile_size : image_width - x_taken;
-            VipsImage *upscaled_image =
-                upscale_tile(upscaler, input_image, &region_rect, &tile_upscale_error);
-
-            if (tile_upscale_error != nullptr) {
-                for (int i = 0; i < tile_count; ++i) {
-                    g_object_unref(upscaled_tiles[i]);
-                }
-                g_propagate_error(error, tile_upscale_error);
-                return nullptr;
+    for (int y = 0; y < strip_height; ++y) {
+        VipsPel *line = VIPS_IMAGE_ADDR(pipeline->output_strip, 0, y);
+        if (vips_image_write_line(pipeline->output_image, pipeline->strip_top + y, line)) {
+            g_set_error_literal(error, KOMELIA_ORT_ERROR, KOMELIA_ORT_ERROR_VIPS, vips_error_buffer());
+            vips_error_clear();
+            return;
+        }
+    }
+    pipeline->strip_top += strip_height;
+}
+
+static gpointer run_postprocessing(gpointer data) {
+    TilePipeline *pipeline = data;
+    const OrtApi *ort_api = pipeline->upscaler->komelia_ort->ort_api;
+
+    while (true) {
+        TileBatch *batch = g_async_queue_pop(pipeline->done_batches);
+        if (batch == &pipeline->stop)
+            break;
+        int scale = pipeline->scale;
+
+        for (int slot = 0; slot < batch->batch_tiles && pipeline->postprocess_error == nullptr; ++slot) {
+            const TileSpan *column_span = &batch->column_spans[slot];
+            const TileSpan *row_span = &batch->row_spans[slot];
+            int tile_index = get_grid_tile_index(pipeline, batch->batch_start + slot);
+            VipsImage *target = pipeline->output_image;
+            int target_left = 0;
+            int target_top = 0;
+            if (pipeline->output_strip != nullptr) {
+                target = pipeline->output_strip;
+                target_top = pipeline->strip_top;
+            } else if (pipeline->tile_images != nullptr) {
+                target = new_output_image(
+                    column_span->core_size * scale,
+                    row_span->core_size * scale,
+                    &pipeline->postprocess_error
+                );
+                if (target == nullptr)
+                    break;
+                target_left = column_span->core_start * scale;
+                target_top = row_span->core_start * scale;
             }
+            VipsRect output_rect;
+            output_rect.left = column_span->core_start * scale - target_left;
+            output_rect.top = row_span->core_start * scale - target_top;
+            output_rect.width = column_span->core_size * scale;
+            output_rect.height = row_span->core_size * scale;
+            int64_t stage_start = komelia_stage_start();
+            write_tile_output(
+                ort_api,
+                batch->result,
+                slot,
+                pipeline->output_tile_width,
+                pipeline->output_tile_height,
+                (column_span->core_start - column_span->tensor_start) * scale,
+                (row_span->core_start - row_span->tensor_start) * scale,
+                target,
+                &output_rect,
+                &pipeline->postprocess_error
+            );
 
-            upscaled_tiles[tile_count] = upscaled_image;
+            if (pipeline->tile_images != nullptr) {
+                // tile is stored only if it was written completely
+                if (pipeline->postprocess_error == nullptr) {
+                    pipeline->tile_images[tile_index] = target;
+                } else {
+                    g_object_unref(target);
+                }
+            }
 
-            x_taken = x_taken + tile_size;
-            if (x_taken > image_width)
-                x_taken = image_width;
-            ++tile_count;
+            bool is_row_end = tile_index % pipeline->grid.row_tiles == pipeline->grid.row_tiles - 1;
+            if (pipeline->output_strip != nullptr && is_row_end && pipeline->postprocess_error == nullptr) {
+                write_output_strip(pipeline, row_span->core_size * scale, &pipeline->postprocess_error);
+            }
+            komelia_stage_end(KOMELIA_STAGE_UPSCALE_POSTPROCESS, stage_start);
         }
 
-        y_taken = y_taken + tile_size;
-        if (y_taken > image_height)
-            y_taken = image_height;
+        if (pipeline->postprocess_error != nullptr) {
+            g_atomic_int_set(&pipeline->cancelled, 1);
+        }
+        g_async_queue_push(pipeline->free_batches, batch);
     }
 
-    int dst_width = 0;
-    int dst_height = 0;
-    for (int i = 0; i < row_tiles; ++i) {
-        dst_width += vips_image_get_width(upscaled_tiles[i]);
+    vips_thread_shutdown();
+    return nullptr;
+}
+
+static void set_grid_batches(
+    KomeliaOrtUpscaler *upscaler,
+    TileGrid *grid,
+    int tile_count
+) {
+    grid->tile_count = tile_count;
+    grid->batch_size = get_batch_size(upscaler, grid->tile_width, grid->tile_height);
+    grid->batch_count = (tile_count + grid->batch_size - 1) / grid->batch_size;
+}
+
+// tile layout of the whole image. Batches are set for processing of all tiles
+static TileGrid get_tile_grid(
+    KomeliaOrtUpscaler *upscaler,
+    VipsImage *input_image,
+    int tile_size
+) {
+    TileGrid grid;
+    grid.image_width = vips_image_get_width(input_image);
+    grid.image_height = vips_image_get_height(input_image);
+    grid.tile_width = min(tile_size, grid.image_width);
+    grid.tile_height = min(tile_size, grid.image_height);
+    // at least 1 pixel of each tile is not overlapped
+    grid.overlap =
+        max(0, min(upscaler->tile_overlap, (min(grid.tile_width, grid.tile_height) - 1) / 2));
+    grid.row_tiles = get_tile_count(grid.image_width, grid.tile_width, grid.overlap);
+    int column_tiles = get_tile_count(grid.image_height, grid.tile_height, grid.overlap);
+    set_grid_batches(upscaler, &grid, grid.row_tiles * column_tiles);
+    return grid;
+}
+
+static void init_pipeline_buffers(
+    TilePipeline *pipeline,
+    GError **error
+) {
+    KomeliaOrtUpscaler *upscaler = pipeline->upscaler;
+    const TileGrid *grid = &pipeline->grid;
+    int pipeline_batches = min(KOMELIA_UPSCALER_PIPELINE_DEPTH, grid->batch_count);
+
+    for (int i = 0; i < pipeline_batches; ++i) {
+        KomeliaOrtIoBuffers *buffers = get_tile_buffers(
+            upscaler,
+            &upscaler->tile_buffers[i],
+            grid->batch_size,
+            grid->tile_width,
+            grid->tile_height,
+            error
+        );
+        if (buffers == nullptr)
+            return;
+        pipeline->batches[i].buffers = buffers;
+        g_async_queue_push(pipeline->free_batches, &pipeline->batches[i]);
     }
-    for (int i = 0; i < column_tiles; ++i) {
-        dst_height += vips_image_get_height(upscaled_tiles[i * row_tiles]);
+}
+
+// called on the first inferred batch, output tile size is not known before that
+static void init_pipeline_output(
+    TilePipeline *pipeline,
+    InferenceResult *result,
+    GError **error
+) {
+    const TileGrid *grid = &pipeline->grid;
+    GError *size_error = nullptr;
+    get_output_tensor_size(
+        pipeline->upscaler->komelia_ort->ort_api,
+        result,
+        &pipeline->output_tile_width,
+        &pipeline->output_tile_height,
+        &size_error
+    );
+    if (size_error != nullptr) {
+        g_propagate_error(error, size_error);
+        return;
     }
 
-    VipsImage *joined = nullptr;
-    vips_arrayjoin(upscaled_tiles, &joined, tile_count, "across", row_tiles, nullptr);
-    for (int i = 0; i < tile_count; ++i) {
-        g_object_unref(upscaled_tiles[i]);
+    int scale = pipeline->output_tile_width / grid->tile_width;
+    if (scale < 1 || pipeline->output_tile_height != grid->tile_height * scale) {
+        g_set_error_literal(
+            error,
+            KOMELIA_ORT_ERROR,
+            KOMELIA_ORT_ERROR_INFERENCE,
+            "Unexpected output tensor shape"
+        );
+        return;
     }
-    if (joined == nullptr) {
-        g_set_error_literal(error, KOMELIA_ORT_ERROR, KOMELIA_ORT_ERROR_VIPS, vips_error_buffer());
-        vips_error_clear();
-        return nullptr;
+    pipeline->scale = scale;
+    if (pipeline->tile_images != nullptr)
+        return;
+    if (!pipeline->upscaler->disk_output && pipeline->output_path == nullptr) {
+        pipeline->output_image =
+            new_output_image(grid->image_width * scale, grid->image_height * scale, error);
+        return;
     }
-    int joined_width = vips_image_get_width(joined);
-    int joined_height = vips_image_get_height(joined);
 
-    if (joined_width != dst_width || joined_height != dst_height) {
-        VipsImage *cropped = nullptr;
-        vips_crop(joined, &cropped, 0, 0, dst_width, dst_height, nullptr);
-        g_object_unref(joined);
+    // first tile row has the largest core height
+    int strip_height = get_tile_span(0, grid->image_height, grid->tile_height, grid->overlap).core_size;
+    pipeline->output_strip = new_output_image(grid->image_width * scale, strip_height * scale, error);
+    if (pipeline->output_strip == nullptr)
+        return;
+    pipeline->output_image =
+        new_disk_output_image(
+            grid->image_width * scale,
+            grid->image_height * scale,
+            pipeline->output_path,
+            error
+        );
+}
 
-        if (cropped == nullptr) {
-            g_set_error_literal(
-                error,
-                KOMELIA_ORT_ERROR,
-                KOMELIA_ORT_ERROR_VIPS,
-                vips_error_buffer()
-            );
-            vips_error_clear();
-            return nullptr;
+// every tile is inferred with the same tensor shape using preallocated input and output tensors.
+// Neighbouring tiles overlap and only the center part of each tile is used to avoid visible seams.
+// Tiles are grouped in batches if model supports it.
+// Batch input is prepared and previous batch output is written to the output on worker threads
+// while the current batch is inferred
+static void run_tile_pipeline(
+    TilePipeline *pipeline,
+    GError **error
+) {
+    KomeliaOrtUpscaler *upscaler = pipeline->upscaler;
+    pipeline->free_batches = g_async_queue_new();
+    pipeline->ready_batches = g_async_queue_new();
+    pipeline->done_batches = g_async_queue_new();
+
+    GError *pipeline_error = nullptr;
+    init_pipeline_buffers(pipeline, &pipeline_error);
+    if (pipeline_error != nullptr) {
+        g_async_queue_unref(pipeline->free_batches);
+        g_async_queue_unref(pipeline->ready_batches);
+        g_async_queue_unref(pipeline->done_batches);
+        g_propagate_error(error, pipeline_error);
+        return;
+    }
+
+    GThread *preprocessing_thread =
+        g_thread_new("komelia-upscale-preprocess", run_preprocessing, pipeline);
+    GThread *postprocessing_thread =
+        g_thread_new("komelia-upscale-postprocess", run_postprocessing, pipeline);
+
+    for (int i = 0; i < pipeline->grid.batch_count; ++i) {
+        TileBatch *batch = g_async_queue_pop(pipeline->ready_batches);
+        if (batch == &pipeline->stop)
+            break;
+        if (batch->error != nullptr) {
+            pipeline_error = batch->error;
+            batch->error = nullptr;
+            break;
+        }
+        if (g_atomic_int_get(&pipeline->cancelled))
+            break;
+
+        int64_t run_start = komelia_stage_start();
+        batch->result = komelia_ort_run_io_binding(
+            upscaler->komelia_ort,
+            upscaler->session,
+            batch->buffers,
+            &pipeline_error
+        );
+        komelia_stage_end(KOMELIA_STAGE_UPSCALE_RUN, run_start);
+        if (pipeline_error != nullptr)
+            break;
+
+        if (pipeline->scale == 0) {
+            init_pipeline_output(pipeline, batch->result, &pipeline_error);
+            if (pipeline_error != nullptr)
+                break;
         }
+        g_async_queue_push(pipeline->done_batches, batch);
+    }
 
-        copy_animation_metadata(input_image, cropped);
-        return cropped;
+    if (pipeline_error != nullptr) {
+        g_atomic_int_set(&pipeline->cancelled, 1);
     }
+    // unblocks preprocessing thread waiting for free batch if inference stopped early
+    g_async_queue_push(pipeline->free_batches, &pipeline->stop);
+    g_async_queue_push(pipeline->done_batches, &pipeline->stop);
+    // time spent waiting for output writes after the last inference
+    int64_t join_start = komelia_stage_start();
+    g_thread_join(postprocessing_thread);
+    komelia_stage_end(KOMELIA_STAGE_UPSCALE_JOIN, join_start);
+    g_thread_join(preprocessing_thread);
+
+    // batch with preprocessing error can be left in the queue if inference stopped first
+    TileBatch *unprocessed_batch;
+    while ((unprocessed_batch = g_async_queue_try_pop(pipeline->ready_batches)) != nullptr) {
+        if (unprocessed_batch->error != nullptr)
+            g_error_free(unprocessed_batch->error);
+    }
+    g_async_queue_unref(pipeline->free_batches);
+    g_async_queue_unref(pipeline->ready_batches);
+    g_async_queue_unref(pipeline->done_batches);
+
+    if (pipeline_error == nullptr && pipeline->postprocess_error != nullptr) {
+        pipeline_error = pipeline->postprocess_error;
+    } else if (pipeline->postprocess_error != nullptr) {
+        g_error_free(pipeline->postprocess_error);
+    }
+    pipeline->postprocess_error = nullptr;
 
-    copy_animation_metadata(input_image, joined);
-    return joined;
+    if (pipeline_error != nullptr) {
+        g_propagate_error(error, pipeline_error);
+    }
+}
+
+static VipsImage *do_tiled_inference(
+    KomeliaOrtUpscaler *upscaler,
+    VipsImage *input_image,
+    const char *output_path,
+    GError **error
+) {
+    TilePipeline pipeline = {0};
+    pipeline.upscaler = upscaler;
+    pipeline.input_image = input_image;
+    pipeline.output_path = output_path;
+    pipeline.grid = get_tile_grid(upscaler, input_image, upscaler->tile_size);
+
+    GError *pipeline_error = nullptr;
+    run_tile_pipeline(&pipeline, &pipeline_error);
+    if (pipeline.output_strip != nullptr)
+        g_object_unref(pipeline.output_strip);
+
+    // reopens written file as lazily mapped input image
+    if (pipeline_error == nullptr && pipeline.output_strip != nullptr &&
+        vips_image_pio_input(pipeline.output_image)) {
+        g_set_error_literal(&pipeline_error, KOMELIA_ORT_ERROR, KOMELIA_ORT_ERROR_VIPS, vips_error_buffer());
+        vips_error_clear();
+    }
+
+    if (pipeline_error != nullptr) {
+        if (pipeline.output_image != nullptr)
+            g_object_unref(pipeline.output_image);
+        g_propagate_error(error, pipeline_error);
+        return nullptr;
+    }
+
+    copy_animation_metadata(input_image, pipeline.output_image);
+    return pipeline.output_image;
 }
 
 static VipsImage *do_full_image_inference(
@@ -398,8 +1025,12 @@ static VipsImage *do_full_image_inference(
     VipsImage *input_image,
     GError **error
 ) {
+    int64_t stage_start = komelia_stage_start();
     KomeliaOrtInputTensor *input_tensor =
         create_tensor(upscaler->session->input_data_type, input_image);
+    komelia_stage_end(KOMELIA_STAGE_UPSCALE_TENSOR_BUILD, stage_start);
+
+    stage_start = komelia_stage_start();
     GError *inference_error = nullptr;
     InferenceResult *inference_result = komelia_ort_run_inference(
         upscaler->komelia_ort,
@@ -407,6 +1038,7 @@ static VipsImage *do_full_image_inference(
         input_tensor,
         &inference_error
     );
+    komelia_stage_end(KOMELIA_STAGE_UPSCALE_RUN, stage_start);
 
     free(input_tensor->data);
     free(input_tensor->shape);
@@ -417,10 +1049,12 @@ static VipsImage *do_full_image_inference(
         return nullptr;
     }
 
+    stage_start = komelia_stage_start();
     GError *out_tensor_error = nullptr;
     VipsImage *tensor_image = get_image_from_tensor(upscaler, inference_result, &out_tensor_error);
+    komelia_stage_end(KOMELIA_STAGE_UPSCALE_POSTPROCESS, stage_start);
     if (out_tensor_error != nullptr) {
-        g_propagate_error(error, inference_error);
+        g_propagate_error(error, out_tensor_error);
         komelia_ort_release_inference_result(upscaler->komelia_ort, inference_result);
         return nullptr;
     }
@@ -533,6 +1167,190 @@ static VipsImage *preprocess_for_inference(
     return transformed;
 }
 
+// must be called with upscaler lock held
+static bool acquire_session(
+    KomeliaOrtUpscaler *upscaler,
+    GError **error
+) {
+    if (upscaler->model_path == nullptr) {
+        g_set_error_literal(
+            error,
+            KOMELIA_ORT_ERROR,
+            KOMELIA_ORT_ERROR_INFERENCE,
+            "model path is not initialized"
+        );
+        return false;
+    }
+    if (upscaler->session != nullptr)
+        return true;
+
+    GError *session_init_error = nullptr;
+    KomeliaOrtSessionKey key = get_session_key(upscaler, upscaler->model_path);
+    SessionData *session = komelia_ort_session_cache_acquire(
+        upscaler->session_cache,
+        &key,
+        &session_init_error
+    );
+    if (session_init_error != nullptr) {
+        g_propagate_error(error, session_init_error);
+        return false;
+    }
+    upscaler->session = session;
+    return true;
+}
+
+static void clear_tile_cache(KomeliaOrtTileCache *cache) {
+    for (int i = 0; i < cache->tile_count; ++i) {
+        if (cache->tiles[i] != nullptr)
+            g_object_unref(cache->tiles[i]);
+    }
+    free(cache->tiles);
+    free(cache->model_path);
+    cache->tiles = nullptr;
+    cache->model_path = nullptr;
+    cache->tile_count = 0;
+    cache->scale = 0;
+}
+
+// drops tiles that were upscaled with different model or tile layout
+static void reset_tile_cache(
+    KomeliaOrtTileCache *cache,
+    KomeliaOrtUpscaler *upscaler,
+    const TileGrid *grid,
+    int tile_size
+) {
+    bool is_same_layout = cache->model_path != nullptr &&
+                          strcmp(cache->model_path, upscaler->model_path) == 0 &&
+                          cache->image_width == grid->image_width &&
+                          cache->image_height == grid->image_height &&
+                          cache->tile_size == tile_size &&
+                          cache->tile_overlap == grid->overlap &&
+                          cache->tile_count == grid->tile_count;
+    if (is_same_layout)
+        return;
+
+    clear_tile_cache(cache);
+    cache->model_path = strdup(upscaler->model_path);
+    cache->image_width = grid->image_width;
+    cache->image_height = grid->image_height;
+    cache->tile_size = tile_size;
+    cache->tile_overlap = grid->overlap;
+    cache->tile_count = grid->tile_count;
+    cache->tiles = calloc(grid->tile_count, sizeof(VipsImage *));
+}
+
+// range of tiles along one image axis with core area intersecting [start, end)
+static void get_tile_range(
+    int start,
+    int end,
+    int image_size,
+    int tensor_size,
+    int overlap,
+    int *first,
+    int *last
+) {
+    if (tensor_size >= image_size) {
+        *first = 0;
+        *last = 0;
+        return;
+    }
+    int core_step = tensor_size - 2 * overlap;
+    int tile_count = get_tile_count(image_size, tensor_size, overlap);
+    *first = min(start / core_step, tile_count - 1);
+    *last = min((end - 1) / core_step, tile_count - 1);
+}
+
+// releases cached tiles further than tile_cache_neighbourhood tiles from the requested tile range.
+// Keeps cache memory proportional to the viewport instead of growing to the whole page while panning
+static void evict_distant_tiles(
+    KomeliaOrtTileCache *cache,
+    const TileGrid *grid,
+    int first_column,
+    int last_column,
+    int first_row,
+    int last_row
+) {
+    for (int tile_index = 0; tile_index < cache->tile_count; ++tile_index) {
+        if (cache->tiles[tile_index] == nullptr)
+            continue;
+        int row = tile_index / grid->row_tiles;
+        int column = tile_index % grid->row_tiles;
+        bool is_near = row >= first_row - tile_cache_neighbourhood &&
+                       row <= last_row + tile_cache_neighbourhood &&
+                       column >= first_column - tile_cache_neighbourhood &&
+                       column <= last_column + tile_cache_neighbourhood;
+        if (!is_near) {
+            g_object_unref(cache->tiles[tile_index]);
+            cache->tiles[tile_index] = nullptr;
+        }
+    }
+}
+
+// copies core areas of cached tiles intersecting the region to a single image
+static VipsImage *compose_region(
+    KomeliaOrtTileCache *cache,
+    const TileGrid *grid,
+    const VipsRect *region,
+    GError **error
+) {
+    int scale = cache->scale;
+    VipsRect output_area = {
+        .left = region->left * scale,
+        .top = region->top * scale,
+        .width = region->width * scale,
+        .height = region->height * scale,
+    };
+    VipsImage *output = new_output_image(output_area.width, output_area.height, error);
+    if (output == nullptr)
+        return nullptr;
+
+    int first_column, last_column, first_row, last_row;
+    get_tile_range(
+        region->left,
+        VIPS_RECT_RIGHT(region),
+        grid->image_width,
+        grid->tile_width,
+        grid->overlap,
+        &first_column,
+        &last_column
+    );
+    get_tile_range(
+        region->top,
+        VIPS_RECT_BOTTOM(region),
+        grid->image_height,
+        grid->tile_height,
+        grid->overlap,
+        &first_row,
+        &last_row
+    );
+
+    for (int row = first_row; row <= last_row; ++row) {
+        TileSpan row_span = get_tile_span(row, grid->image_height, grid->tile_height, grid->overlap);
+        for (int column = first_column; column <= last_column; ++column) {
+            TileSpan column_span = get_tile_span(column, grid->image_width, grid->tile_width, grid->overlap);
+            VipsImage *tile = cache->tiles[row * grid->row_tiles + column];
+            VipsRect tile_area = {
+                .left = column_span.core_start * scale,
+                .top = row_span.core_start * scale,
+                .width = column_span.core_size * scale,
+                .height = row_span.core_size * scale,
+            };
+            VipsRect copy_area;
+            vips_rect_intersectrect(&tile_area, &output_area, &copy_area);
+
+            size_t line_size = (size_t)copy_area.width * 3;
+            for (int y = copy_area.top; y < VIPS_RECT_BOTTOM(&copy_area); ++y) {
+                memcpy(
+                    VIPS_IMAGE_ADDR(output, copy_area.left - output_area.left, y - output_area.top),
+                    VIPS_IMAGE_ADDR(tile, copy_area.left - tile_area.left, y - tile_area.top),
+                    line_size
+                );
+            }
+        }
+    }
+    return output;
+}
+
 KomeliaOrtUpscaler *komelia_ort_upscaler_create(KomeliaOrt *ort) {
     KomeliaOrtUpscaler *upscaler = malloc(sizeof(KomeliaOrtUpscaler));
     upscaler->komelia_ort = ort;
@@ -540,7 +1358,15 @@ KomeliaOrtUpscaler *komelia_ort_upscaler_create(KomeliaOrt *ort) {
     upscaler->device_id = 0;
     upscaler->model_path = nullptr;
     upscaler->session = nullptr;
+    upscaler->session_cache = komelia_ort_session_cache_create(ort);
+    for (int i = 0; i < KOMELIA_UPSCALER_PIPELINE_DEPTH; ++i) {
+        upscaler->tile_buffers[i] = nullptr;
+    }
     upscaler->tile_size = 0;
+    upscaler->tile_overlap = 16;
+    upscaler->max_batch_size = 4;
+    upscaler->batch_memory_limit = (size_t)1024 * 1024 * 1024;
+    upscaler->disk_output = false;
     pthread_mutex_init(&upscaler->mutex, nullptr);
     return upscaler;
 }
@@ -548,9 +1374,8 @@ KomeliaOrtUpscaler *komelia_ort_upscaler_create(KomeliaOrt *ort) {
 void komelia_ort_upscaler_destroy(KomeliaOrtUpscaler *upscaler) {
     free(upscaler->model_path);
     pthread_mutex_destroy(&upscaler->mutex);
-    if (upscaler->session != nullptr) {
-        komelia_ort_close_session(upscaler->komelia_ort, upscaler->session);
-    }
+    release_session(upscaler);
+    komelia_ort_session_cache_destroy(upscaler->session_cache);
     free(upscaler);
 }
 
@@ -561,10 +1386,7 @@ void komelia_ort_upscaler_set_tile_size(
     pthread_mutex_lock(&upscaler->mutex);
     if (upscaler->tile_size != size) {
         upscaler->tile_size = size;
-        if (upscaler->session != nullptr) {
-            komelia_ort_close_session(upscaler->komelia_ort, upscaler->session);
-            upscaler->session = nullptr;
-        }
+        release_session(upscaler);
     }
     pthread_mutex_unlock(&upscaler->mutex);
 }
@@ -585,10 +1407,7 @@ void komelia_ort_upscaler_set_model_path(
     }
     upscaler->model_path = model_path_copy;
 
-    if (upscaler->session != nullptr) {
-        komelia_ort_close_session(upscaler->komelia_ort, upscaler->session);
-        upscaler->session = nullptr;
-    }
+    release_session(upscaler);
 
     pthread_mutex_unlock(&upscaler->mutex);
 }
@@ -602,56 +1421,100 @@ void komelia_ort_upscaler_set_execution_provider(
     if (upscaler->execution_provider != execution_provider || upscaler->device_id != device_id) {
         upscaler->execution_provider = execution_provider;
         upscaler->device_id = device_id;
-        if (upscaler->session != nullptr) {
-            komelia_ort_close_session(upscaler->komelia_ort, upscaler->session);
-            upscaler->session = nullptr;
-        }
+        release_session(upscaler);
     }
 
     pthread_mutex_unlock(&upscaler->mutex);
 }
 
+void komelia_ort_upscaler_set_thread_count(
+    KomeliaOrtUpscaler *upscaler,
+    int intra_op_threads,
+    int inter_op_threads
+) {
+    pthread_mutex_lock(&upscaler->mutex);
+    if (upscaler->threads.intra_op_threads != intra_op_threads ||
+        upscaler->threads.inter_op_threads != inter_op_threads) {
+        upscaler->threads.intra_op_threads = intra_op_threads;
+        upscaler->threads.inter_op_threads = inter_op_threads;
+        release_session(upscaler);
+    }
+    pthread_mutex_unlock(&upscaler->mutex);
+}
+
+void komelia_ort_upscaler_set_tile_overlap(
+    KomeliaOrtUpscaler *upscaler,
+    int overlap
+) {
+    pthread_mutex_lock(&upscaler->mutex);
+    upscaler->tile_overlap = overlap;
+    pthread_mutex_unlock(&upscaler->mutex);
+}
+
+void komelia_ort_upscaler_set_batch_size(
+    KomeliaOrtUpscaler *upscaler,
+    int max_batch_size,
+    size_t memory_limit
+) {
+    pthread_mutex_lock(&upscaler->mutex);
+    if (upscaler->max_batch_size != max_batch_size || upscaler->batch_memory_limit != memory_limit) {
+        upscaler->max_batch_size = max_batch_size;
+        upscaler->batch_memory_limit = memory_limit;
+        release_tile_buffers(upscaler);
+    }
+    pthread_mutex_unlock(&upscaler->mutex);
+}
+
+void komelia_ort_upscaler_set_disk_output(
+    KomeliaOrtUpscaler *upscaler,
+    bool enabled
+) {
+    pthread_mutex_lock(&upscaler->mutex);
+    upscaler->disk_output = enabled;
+    pthread_mutex_unlock(&upscaler->mutex);
+}
+
+void komelia_ort_upscaler_set_session_cache_limits(
+    KomeliaOrtUpscaler *upscaler,
+    int max_sessions,
+    size_t memory_limit
+) {
+    komelia_ort_session_cache_set_limits(upscaler->session_cache, max_sessions, memory_limit);
+}
+
+void komelia_ort_upscaler_warm_up(
+    KomeliaOrtUpscaler *upscaler,
+    const char *model_path
+) {
+    pthread_mutex_lock(&upscaler->mutex);
+    KomeliaOrtSessionKey key = get_session_key(upscaler, model_path);
+    komelia_ort_session_cache_warm_up(upscaler->session_cache, &key);
+    pthread_mutex_unlock(&upscaler->mutex);
+}
+
 void komelia_ort_upscaler_close_session(KomeliaOrtUpscaler *upscaler) {
     pthread_mutex_lock(&upscaler->mutex);
-    komelia_ort_close_session(upscaler->komelia_ort, upscaler->session);
-    upscaler->session = nullptr;
+    release_session(upscaler);
+    komelia_ort_session_cache_clear(upscaler->session_cache);
     pthread_mutex_unlock(&upscaler->mutex);
 }
 
-VipsImage *komelia_ort_upscale(
+static VipsImage *upscale_image(
     KomeliaOrtUpscaler *upscaler,
     VipsImage *image,
+    const char *output_path,
     GError **error
 ) {
     pthread_mutex_lock(&upscaler->mutex);
-    if (upscaler->model_path == nullptr) {
-        g_set_error_literal(
-            error,
-            KOMELIA_ORT_ERROR,
-            KOMELIA_ORT_ERROR_INFERENCE,
-            "model path is not initialized"
-        );
+    if (!acquire_session(upscaler, error)) {
+        pthread_mutex_unlock(&upscaler->mutex);
         return nullptr;
     }
 
-    if (upscaler->session == nullptr) {
-        GError *session_init_error = nullptr;
-        SessionData *session = komelia_ort_create_session(
-            upscaler->komelia_ort,
-            upscaler->execution_provider,
-            upscaler->device_id,
-            upscaler->model_path,
-            &session_init_error
-        );
-        if (session_init_error != nullptr) {
-            g_propagate_error(error, session_init_error);
-            return nullptr;
-        }
-        upscaler->session = session;
-    }
-
     GError *preprocessing_error = nullptr;
+    int64_t preprocess_start = komelia_stage_start();
     VipsImage *preprocessed_image = preprocess_for_inference(image, &preprocessing_error);
+    komelia_stage_end(KOMELIA_STAGE_UPSCALE_PREPROCESS, preprocess_start);
     if (preprocessing_error != nullptr) {
         g_propagate_error(error, preprocessing_error);
         pthread_mutex_unlock(&upscaler->mutex);
@@ -663,10 +1526,11 @@ VipsImage *komelia_ort_upscale(
     VipsImage *upscaled_image;
     GError *upscale_error = nullptr;
     if (upscaler->tile_size != 0 && input_width * input_height > tile_threshold) {
-        upscaled_image = do_tiled_inference(upscaler, preprocessed_image, &upscale_error);
+        upscaled_image = do_tiled_inference(upscaler, preprocessed_image, output_path, &upscale_error);
     } else {
         upscaled_image = do_full_image_inference(upscaler, preprocessed_image, &upscale_error);
     }
+    g_object_unref(preprocessed_image);
 
     if (upscale_error != nullptr) {
         g_propagate_error(error, upscale_error);
@@ -676,4 +1540,156 @@ VipsImage *komelia_ort_upscale(
 
     pthread_mutex_unlock(&upscaler->mutex);
     return upscaled_image;
-}
\ No newline at end of file
+}
+
+VipsImage *komelia_ort_upscale(
+    KomeliaOrtUpscaler *upscaler,
+    VipsImage *image,
+    GError **error
+) {
+    return upscale_image(upscaler, image, nullptr, error);
+}
+
+bool komelia_ort_upscale_to_file(
+    KomeliaOrtUpscaler *upscaler,
+    VipsImage *image,
+    const char *path,
+    GError **error
+) {
+    GError *upscale_error = nullptr;
+    VipsImage *upscaled_image = upscale_image(upscaler, image, path, &upscale_error);
+    if (upscale_error != nullptr) {
+        g_propagate_error(error, upscale_error);
+        return false;
+    }
+
+    // tiled output is already streamed to the file. Image is closed before the file is passed to the caller
+    const char *written_path = vips_image_get_filename(upscaled_image);
+    if (written_path == nullptr || strcmp(written_path, path) != 0) {
+        if (vips_vipssave(upscaled_image, path, nullptr)) {
+            g_set_error_literal(error, KOMELIA_ORT_ERROR, KOMELIA_ORT_ERROR_VIPS, vips_error_buffer());
+            vips_error_clear();
+            g_object_unref(upscaled_image);
+            return false;
+        }
+    }
+    g_object_unref(upscaled_image);
+    return true;
+}
+KomeliaOrtTileCache *komelia_ort_tile_cache_create() {
+    KomeliaOrtTileCache *cache = malloc(sizeof(KomeliaOrtTileCache));
+    cache->model_path = nullptr;
+    cache->image_width = 0;
+    cache->image_height = 0;
+    cache->tile_size = 0;
+    cache->tile_overlap = 0;
+    cache->scale = 0;
+    cache->tile_count = 0;
+    cache->tiles = nullptr;
+    return cache;
+}
+
+void komelia_ort_tile_cache_destroy(KomeliaOrtTileCache *cache) {
+    clear_tile_cache(cache);
+    free(cache);
+}
+
+VipsImage *komelia_ort_upscale_region(
+    KomeliaOrtUpscaler *upscaler,
+    KomeliaOrtTileCache *cache,
+    VipsImage *image,
+    const VipsRect *rect,
+    GError **error
+) {
+    pthread_mutex_lock(&upscaler->mutex);
+    if (!acquire_session(upscaler, error)) {
+        pthread_mutex_unlock(&upscaler->mutex);
+        return nullptr;
+    }
+
+    VipsRect image_rect = {
+        .left = 0,
+        .top = 0,
+        .width = vips_image_get_width(image),
+        .height = vips_image_get_height(image),
+    };
+    VipsRect region;
+    vips_rect_intersectrect(rect, &image_rect, &region);
+    if (vips_rect_isempty(&region)) {
+        g_set_error_literal(error, KOMELIA_ORT_ERROR, KOMELIA_ORT_ERROR_VIPS, "region is outside of the image");
+        pthread_mutex_unlock(&upscaler->mutex);
+        return nullptr;
+    }
+
+    GError *upscale_error = nullptr;
+    int64_t preprocess_start = komelia_stage_start();
+    VipsImage *preprocessed_image = preprocess_for_inference(image, &upscale_error);
+    komelia_stage_end(KOMELIA_STAGE_UPSCALE_PREPROCESS, preprocess_start);
+    if (upscale_error != nullptr) {
+        g_propagate_error(error, upscale_error);
+        pthread_mutex_unlock(&upscaler->mutex);
+        return nullptr;
+    }
+
+    int tile_size = upscaler->tile_size != 0 ? upscaler->tile_size : region_tile_size;
+    TileGrid grid = get_tile_grid(upscaler, preprocessed_image, tile_size);
+    reset_tile_cache(cache, upscaler, &grid, tile_size);
+
+    int first_column, last_column, first_row, last_row;
+    get_tile_range(
+        region.left,
+        VIPS_RECT_RIGHT(&region),
+        grid.image_width,
+        grid.tile_width,
+        grid.overlap,
+        &first_column,
+        &last_column
+    );
+    get_tile_range(
+        region.top,
+        VIPS_RECT_BOTTOM(&region),
+        grid.image_height,
+        grid.tile_height,
+        grid.overlap,
+        &first_row,
+        &last_row
+    );
+
+    evict_distant_tiles(cache, &grid, first_column, last_column, first_row, last_row);
+
+    int *missing_tiles = malloc(sizeof(int) * grid.tile_count);
+    int missing_count = 0;
+    for (int row = first_row; row <= last_row; ++row) {
+        for (int column = first_column; column <= last_column; ++column) {
+            int tile_index = row * grid.row_tiles + column;
+            if (cache->tiles[tile_index] == nullptr)
+                missing_tiles[missing_count++] = tile_index;
+        }
+    }
+
+    if (missing_count > 0) {
+        TilePipeline pipeline = {0};
+        pipeline.upscaler = upscaler;
+        pipeline.input_image = preprocessed_image;
+        pipeline.grid = grid;
+        set_grid_batches(upscaler, &pipeline.grid, missing_count);
+        pipeline.tile_indices = missing_tiles;
+        pipeline.tile_images = cache->tiles;
+        run_tile_pipeline(&pipeline, &upscale_error);
+        if (pipeline.scale != 0)
+            cache->scale = pipeline.scale;
+    }
+    free(missing_tiles);
+    g_object_unref(preprocessed_image);
+
+    VipsImage *upscaled_region = nullptr;
+    if (upscale_error == nullptr) {
+        upscaled_region = compose_region(cache, &grid, &region, &upscale_error);
+    }
+    if (upscale_error != nullptr) {
+        g_propagate_error(error, upscale_error);
+    }
+
+    pthread_mutex_unlock(&upscaler->mutex);
+    return upscaled_region;
+}
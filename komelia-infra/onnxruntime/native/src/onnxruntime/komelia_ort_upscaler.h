@@ -3,17 +3,48 @@
 
 #include <pthread.h>
 #include "komelia_onnxruntime.h"
+#include "komelia_ort_session_cache.h"
+
+// number of tile batches that are prepared, inferred and written to output image concurrently
+#define KOMELIA_UPSCALER_PIPELINE_DEPTH 3
+#define KOMELIA_UPSCALER_MAX_BATCH_SIZE 32
 
 typedef struct {
     KomeliaOrt *komelia_ort;
     KomeliaOrtExecutionProvider execution_provider;
     int device_id;
     char *model_path;
+    // acquired from session cache for current model and provider
     SessionData *session;
+    KomeliaOrtSessionCache *session_cache;
+    KomeliaOrtIoBuffers *tile_buffers[KOMELIA_UPSCALER_PIPELINE_DEPTH];
+    KomeliaOrtThreadConfig threads;
     int tile_size;
+    // pixels on each tile side that are inferred but discarded from the output
+    int tile_overlap;
+    // only used by models with dynamic batch dimension
+    int max_batch_size;
+    size_t batch_memory_limit;
+    // tiled output is written to temporary file instead of memory
+    bool disk_output;
     pthread_mutex_t mutex;
 } KomeliaOrtUpscaler;
 
+// Upscaled tiles of a single page. Tiles are added as regions of the page are upscaled
+// and reused by following region upscales with the same model and tile layout.
+// Tiles far from the last upscaled region are released
+typedef struct {
+    char *model_path;
+    int image_width;
+    int image_height;
+    int tile_size;
+    int tile_overlap;
+    int scale;
+    int tile_count;
+    // core area of each tile in grid order, nullptr if tile wasn't upscaled yet
+    VipsImage **tiles;
+} KomeliaOrtTileCache;
+
 KomeliaOrtUpscaler *komelia_ort_upscaler_create(KomeliaOrt *ort);
 
 void komelia_ort_upscaler_destroy(KomeliaOrtUpscaler *upscaler);
@@ -23,6 +54,18 @@ void komelia_ort_upscaler_set_tile_size(
     int size
 );
 
+void komelia_ort_upscaler_set_tile_overlap(
+    KomeliaOrtUpscaler *upscaler,
+    int overlap
+);
+
+// memory limit applies to batch input and output tensors
+void komelia_ort_upscaler_set_batch_size(
+    KomeliaOrtUpscaler *upscaler,
+    int max_batch_size,
+    size_t memory_limit
+);
+
 void komelia_ort_upscaler_set_model_path(
     KomeliaOrtUpscaler *upscaler,
     const char *path
@@ -34,6 +77,35 @@ void komelia_ort_upscaler_set_execution_provider(
     int device_id
 );
 
+void komelia_ort_upscaler_set_thread_count(
+    KomeliaOrtUpscaler *upscaler,
+    int intra_op_threads,
+    int inter_op_threads
+);
+
+// Tiled upscale results are streamed to a temporary vips file one tile row at a time
+// and returned as an image lazily mapped from that file. Output memory is bounded by a single tile row.
+// File is deleted when returned image is closed
+void komelia_ort_upscaler_set_disk_output(
+    KomeliaOrtUpscaler *upscaler,
+    bool enabled
+);
+
+// limits for sessions kept open after model or provider switch
+void komelia_ort_upscaler_set_session_cache_limits(
+    KomeliaOrtUpscaler *upscaler,
+    int max_sessions,
+    size_t memory_limit
+);
+
+// creates session for the model in background with current provider and tile size.
+// Next switch to this model reuses created session
+void komelia_ort_upscaler_warm_up(
+    KomeliaOrtUpscaler *upscaler,
+    const char *model_path
+);
+
+// closes current and all cached sessions
 void komelia_ort_upscaler_close_session(KomeliaOrtUpscaler *upscaler);
 
 VipsImage *komelia_ort_upscale(
@@ -42,4 +114,29 @@ VipsImage *komelia_ort_upscale(
     GError **error
 );
 
+// writes upscaled image to a vips file at path, path must have .v suffix.
+// Tiled output is streamed to the file directly regardless of disk output setting.
+// File is closed when function returns and can be moved by the caller
+bool komelia_ort_upscale_to_file(
+    KomeliaOrtUpscaler *upscaler,
+    VipsImage *image,
+    const char *path,
+    GError **error
+);
+
+KomeliaOrtTileCache *komelia_ort_tile_cache_create();
+
+void komelia_ort_tile_cache_destroy(KomeliaOrtTileCache *cache);
+
+// upscales only tiles covering the rect that are missing from the cache.
+// Tiles are inferred with the same overlapping context as in full image upscale, so results are seamless.
+// Returns upscaled area of the rect. Cache must not be used concurrently with other upscalers
+VipsImage *komelia_ort_upscale_region(
+    KomeliaOrtUpscaler *upscaler,
+    KomeliaOrtTileCache *cache,
+    VipsImage *image,
+    const VipsRect *rect,
+    GError **error
+);
+
 #endif // KOMELIA_ORT_UPSCALER
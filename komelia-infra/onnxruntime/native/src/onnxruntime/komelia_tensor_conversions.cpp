@@ -0,0 +1,386 @@
+#include "komelia_tensor_conversions.h"
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "komelia_tensor_conversions.cpp"
+#include <hwy/foreach_target.h> // IWYU pragma: keep
+#include <hwy/highway.h>
+
+#include <cmath>
+
+HWY_BEFORE_NAMESPACE();
+
+namespace komelia::HWY_NAMESPACE {
+namespace hn = hwy::HWY_NAMESPACE;
+
+using FloatTag = hn::ScalableTag<float>;
+using PixelTag = hn::Rebind<uint8_t, FloatTag>;
+using IntTag = hn::Rebind<int32_t, FloatTag>;
+using HalfTag = hn::Rebind<hwy::float16_t, FloatTag>;
+
+HWY_INLINE void store_values(FloatTag d, hn::Vec<FloatTag> values, float *HWY_RESTRICT output) {
+    hn::StoreU(values, d, output);
+}
+
+HWY_INLINE void store_values(FloatTag, hn::Vec<FloatTag> values, hwy::float16_t *HWY_RESTRICT output) {
+    const HalfTag dh;
+    hn::StoreU(hn::DemoteTo(dh, values), dh, output);
+}
+
+HWY_INLINE hn::Vec<FloatTag> load_values(FloatTag d, const float *HWY_RESTRICT input) {
+    return hn::LoadU(d, input);
+}
+
+HWY_INLINE hn::Vec<FloatTag> load_values(FloatTag d, const hwy::float16_t *HWY_RESTRICT input) {
+    const HalfTag dh;
+    return hn::PromoteTo(d, hn::LoadU(dh, input));
+}
+
+HWY_INLINE void store_value(float value, float *output) { *output = value; }
+HWY_INLINE void store_value(float value, hwy::float16_t *output) { *output = hwy::F16FromF32(value); }
+HWY_INLINE float load_value(float value) { return value; }
+HWY_INLINE float load_value(hwy::float16_t value) { return hwy::F32FromF16(value); }
+
+HWY_INLINE uint8_t to_pixel_value(float value) {
+    value = HWY_MIN(HWY_MAX(value, 0.f), 1.f);
+    return (uint8_t)std::nearbyint(value * 255.f);
+}
+
+HWY_INLINE hn::Vec<FloatTag> to_tensor_values(
+    IntTag di,
+    FloatTag df,
+    hn::Vec<PixelTag> pixels,
+    hn::Vec<FloatTag> scale,
+    hn::Vec<FloatTag> bias
+) {
+    return hn::MulAdd(hn::ConvertTo(df, hn::PromoteTo(di, pixels)), scale, bias);
+}
+
+HWY_INLINE hn::Vec<PixelTag> to_pixel_values(
+    PixelTag du8,
+    FloatTag df,
+    hn::Vec<FloatTag> values
+) {
+    values = hn::Min(hn::Max(values, hn::Zero(df)), hn::Set(df, 1.f));
+    return hn::DemoteTo(du8, hn::NearestInt(hn::Mul(values, hn::Set(df, 255.f))));
+}
+
+template <typename T>
+void rgb_to_tensor(
+    const uint8_t *input,
+    size_t input_stride,
+    int input_width,
+    int input_height,
+    int tensor_width,
+    int tensor_height,
+    const KomeliaTensorNormalization *normalization,
+    T *output,
+    bool parallel
+) {
+    const size_t plane_size = (size_t)tensor_width * tensor_height;
+    const int vector_width = HWY_MIN(input_width, tensor_width);
+
+#pragma omp parallel for if(parallel) shared(input, input_stride, input_width, input_height, tensor_width, tensor_height, normalization, output, plane_size, vector_width) default(none)
+    for (int y = 0; y < tensor_height; ++y) {
+        const FloatTag df;
+        const PixelTag du8;
+        const IntTag di;
+        const int lanes = (int)hn::Lanes(df);
+        const auto scale_r = hn::Set(df, normalization->scale[0]);
+        const auto scale_g = hn::Set(df, normalization->scale[1]);
+        const auto scale_b = hn::Set(df, normalization->scale[2]);
+        const auto bias_r = hn::Set(df, normalization->bias[0]);
+        const auto bias_g = hn::Set(df, normalization->bias[1]);
+        const auto bias_b = hn::Set(df, normalization->bias[2]);
+
+        const uint8_t *input_row = input + (size_t)HWY_MIN(y, input_height - 1) * input_stride;
+        T *output_r = output + (size_t)y * tensor_width;
+        T *output_g = output_r + plane_size;
+        T *output_b = output_g + plane_size;
+
+        int x = 0;
+        for (; x + lanes <= vector_width; x += lanes) {
+            hn::Vec<PixelTag> r, g, b;
+            hn::LoadInterleaved3(du8, input_row + (size_t)x * 3, r, g, b);
+            store_values(df, to_tensor_values(di, df, r, scale_r, bias_r), output_r + x);
+            store_values(df, to_tensor_values(di, df, g, scale_g, bias_g), output_g + x);
+            store_values(df, to_tensor_values(di, df, b, scale_b, bias_b), output_b + x);
+        }
+        for (; x < tensor_width; ++x) {
+            const uint8_t *pixel = input_row + (size_t)HWY_MIN(x, input_width - 1) * 3;
+            store_value(pixel[0] * normalization->scale[0] + normalization->bias[0], output_r + x);
+            store_value(pixel[1] * normalization->scale[1] + normalization->bias[1], output_g + x);
+            store_value(pixel[2] * normalization->scale[2] + normalization->bias[2], output_b + x);
+        }
+    }
+}
+
+template <typename T>
+void tensor_to_rgb(
+    const T *tensor,
+    int tensor_width,
+    int tensor_height,
+    int tensor_left,
+    int tensor_top,
+    int width,
+    int height,
+    uint8_t *output,
+    size_t output_stride,
+    bool parallel
+) {
+    const size_t plane_size = (size_t)tensor_width * tensor_height;
+
+#pragma omp parallel for if(parallel) shared(tensor, tensor_width, tensor_left, tensor_top, width, height, output, output_stride, plane_size) default(none)
+    for (int y = 0; y < height; ++y) {
+        const FloatTag df;
+        const PixelTag du8;
+        const int lanes = (int)hn::Lanes(df);
+
+        const T *tensor_r = tensor + (size_t)(tensor_top + y) * tensor_width + tensor_left;
+        const T *tensor_g = tensor_r + plane_size;
+        const T *tensor_b = tensor_g + plane_size;
+        uint8_t *output_row = output + (size_t)y * output_stride;
+
+        int x = 0;
+        for (; x + lanes <= width; x += lanes) {
+            hn::StoreInterleaved3(
+                to_pixel_values(du8, df, load_values(df, tensor_r + x)),
+                to_pixel_values(du8, df, load_values(df, tensor_g + x)),
+                to_pixel_values(du8, df, load_values(df, tensor_b + x)),
+                du8,
+                output_row + (size_t)x * 3
+            );
+        }
+        for (; x < width; ++x) {
+            output_row[x * 3] = to_pixel_value(load_value(tensor_r[x]));
+            output_row[x * 3 + 1] = to_pixel_value(load_value(tensor_g[x]));
+            output_row[x * 3 + 2] = to_pixel_value(load_value(tensor_b[x]));
+        }
+    }
+}
+
+void rgb_to_tensor_f32(
+    const uint8_t *input,
+    size_t input_stride,
+    int input_width,
+    int input_height,
+    int tensor_width,
+    int tensor_height,
+    const KomeliaTensorNormalization *normalization,
+    void *output,
+    bool parallel
+) {
+    rgb_to_tensor(
+        input,
+        input_stride,
+        input_width,
+        input_height,
+        tensor_width,
+        tensor_height,
+        normalization,
+        static_cast<float *>(output),
+        parallel
+    );
+}
+
+void rgb_to_tensor_f16(
+    const uint8_t *input,
+    size_t input_stride,
+    int input_width,
+    int input_height,
+    int tensor_width,
+    int tensor_height,
+    const KomeliaTensorNormalization *normalization,
+    void *output,
+    bool parallel
+) {
+    rgb_to_tensor(
+        input,
+        input_stride,
+        input_width,
+        input_height,
+        tensor_width,
+        tensor_height,
+        normalization,
+        static_cast<hwy::float16_t *>(output),
+        parallel
+    );
+}
+
+void tensor_to_rgb_f32(
+    const void *tensor,
+    int tensor_width,
+    int tensor_height,
+    int tensor_left,
+    int tensor_top,
+    int width,
+    int height,
+    uint8_t *output,
+    size_t output_stride,
+    bool parallel
+) {
+    tensor_to_rgb(
+        static_cast<const float *>(tensor),
+        tensor_width,
+        tensor_height,
+        tensor_left,
+        tensor_top,
+        width,
+        height,
+        output,
+        output_stride,
+        parallel
+    );
+}
+
+void tensor_to_rgb_f16(
+    const void *tensor,
+    int tensor_width,
+    int tensor_height,
+    int tensor_left,
+    int tensor_top,
+    int width,
+    int height,
+    uint8_t *output,
+    size_t output_stride,
+    bool parallel
+) {
+    tensor_to_rgb(
+        static_cast<const hwy::float16_t *>(tensor),
+        tensor_width,
+        tensor_height,
+        tensor_left,
+        tensor_top,
+        width,
+        height,
+        output,
+        output_stride,
+        parallel
+    );
+}
+
+} // namespace komelia::HWY_NAMESPACE
+
+HWY_AFTER_NAMESPACE();
+
+#if HWY_ONCE
+
+extern "C" const KomeliaTensorNormalization komelia_unit_normalization = {
+    {1.f / 255.f, 1.f / 255.f, 1.f / 255.f},
+    {0.f, 0.f, 0.f},
+};
+
+// c linkage functions are defined in the namespace of dispatch tables
+namespace komelia {
+HWY_EXPORT(rgb_to_tensor_f32);
+HWY_EXPORT(rgb_to_tensor_f16);
+HWY_EXPORT(tensor_to_rgb_f32);
+HWY_EXPORT(tensor_to_rgb_f16);
+
+extern "C" void komelia_rgb_to_tensor(
+    const uint8_t *input,
+    size_t input_stride,
+    int input_width,
+    int input_height,
+    int tensor_width,
+    int tensor_height,
+    const KomeliaTensorNormalization *normalization,
+    float *output,
+    bool parallel
+) {
+    HWY_DYNAMIC_DISPATCH(rgb_to_tensor_f32)(
+        input,
+        input_stride,
+        input_width,
+        input_height,
+        tensor_width,
+        tensor_height,
+        normalization,
+        output,
+        parallel
+    );
+}
+
+extern "C" void komelia_rgb_to_tensor_f16(
+    const uint8_t *input,
+    size_t input_stride,
+    int input_width,
+    int input_height,
+    int tensor_width,
+    int tensor_height,
+    const KomeliaTensorNormalization *normalization,
+    void *output,
+    bool parallel
+) {
+    HWY_DYNAMIC_DISPATCH(rgb_to_tensor_f16)(
+        input,
+        input_stride,
+        input_width,
+        input_height,
+        tensor_width,
+        tensor_height,
+        normalization,
+        output,
+        parallel
+    );
+}
+
+extern "C" void komelia_tensor_to_rgb(
+    const float *tensor,
+    int tensor_width,
+    int tensor_height,
+    int tensor_left,
+    int tensor_top,
+    int width,
+    int height,
+    uint8_t *output,
+    size_t output_stride,
+    bool parallel
+) {
+    HWY_DYNAMIC_DISPATCH(tensor_to_rgb_f32)(
+        tensor,
+        tensor_width,
+        tensor_height,
+        tensor_left,
+        tensor_top,
+        width,
+        height,
+        output,
+        output_stride,
+        parallel
+    );
+}
+
+extern "C" void komelia_tensor_to_rgb_f16(
+    const void *tensor,
+    int tensor_width,
+    int tensor_height,
+    int tensor_left,
+    int tensor_top,
+    int width,
+    int height,
+    uint8_t *output,
+    size_t output_stride,
+    bool parallel
+) {
+    HWY_DYNAMIC_DISPATCH(tensor_to_rgb_f16)(
+        tensor,
+        tensor_width,
+        tensor_height,
+        tensor_left,
+        tensor_top,
+        width,
+        height,
+        output,
+        output_stride,
+        parallel
+    );
+}
+
+extern "C" const char *komelia_cpu_target_name(void) {
+    // targets are ordered from best to worst by increasing bit value
+    const int64_t targets = hwy::SupportedTargets();
+    return hwy::TargetName(targets & -targets);
+}
+} // namespace komelia
+
+#endif // HWY_ONCE
@@ -0,0 +1,89 @@
+#ifndef KOMELIA_TENSOR_CONVERSIONS_H
+#define KOMELIA_TENSOR_CONVERSIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Vectorized conversions between 8 bit rgb pixels and [c,h,w] model tensors.
+// Implementation is selected at runtime for the best instruction set supported by the cpu.
+// Rows are split between OpenMP threads only if parallel is set. Callers that already run
+// on multiple threads (e.g. tile pipeline) should pass false to avoid oversubscribing cores
+
+// per channel transform of pixel values written to the tensor: value = pixel * scale + bias
+typedef struct {
+    float scale[3];
+    float bias[3];
+} KomeliaTensorNormalization;
+
+// maps pixel values to [0,1] range
+extern const KomeliaTensorNormalization komelia_unit_normalization;
+
+// [h,w,c] pixels to [c,h,w] tensor.
+// tensor area outside of input is filled by repeating the last input row and column
+void komelia_rgb_to_tensor(
+    const uint8_t *input,
+    size_t input_stride,
+    int input_width,
+    int input_height,
+    int tensor_width,
+    int tensor_height,
+    const KomeliaTensorNormalization *normalization,
+    float *output,
+    bool parallel
+);
+
+// same as komelia_rgb_to_tensor with half precision output
+void komelia_rgb_to_tensor_f16(
+    const uint8_t *input,
+    size_t input_stride,
+    int input_width,
+    int input_height,
+    int tensor_width,
+    int tensor_height,
+    const KomeliaTensorNormalization *normalization,
+    void *output,
+    bool parallel
+);
+
+// copies width x height area of [c,h,w] tensor starting at tensor_left, tensor_top to [h,w,c] pixels.
+// tensor values are clamped to [0,1] range
+void komelia_tensor_to_rgb(
+    const float *tensor,
+    int tensor_width,
+    int tensor_height,
+    int tensor_left,
+    int tensor_top,
+    int width,
+    int height,
+    uint8_t *output,
+    size_t output_stride,
+    bool parallel
+);
+
+// same as komelia_tensor_to_rgb with half precision input
+void komelia_tensor_to_rgb_f16(
+    const void *tensor,
+    int tensor_width,
+    int tensor_height,
+    int tensor_left,
+    int tensor_top,
+    int width,
+    int height,
+    uint8_t *output,
+    size_t output_stride,
+    bool parallel
+);
+
+// name of the best instruction set target supported by the cpu, e.g. "AVX2" or "NEON"
+const char *komelia_cpu_target_name(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // KOMELIA_TENSOR_CONVERSIONS_H
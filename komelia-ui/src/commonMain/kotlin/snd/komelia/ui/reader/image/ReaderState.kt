@@ -16,6 +16,7 @@ import kotlinx.coroutines.launch
 import snd.komelia.AppNotification
 import snd.komelia.AppNotifications
 import snd.komelia.color.repository.BookColorCorrectionRepository
+import snd.komelia.image.BookImageLoader
 import snd.komelia.image.ReaderImage.PageId
 import snd.komelia.image.ReduceKernel
 import snd.komelia.image.UpsamplingMode
@@ -45,6 +46,7 @@ typealias SpreadIndex = Int
 
 class ReaderState(
     private val bookApi: KomgaBookApi,
+    private val imageLoader: BookImageLoader,
     private val seriesApi: KomgaSeriesApi,
     private val readListApi: KomgaReadListApi,
     private val navigator: Navigator,
@@ -141,6 +143,12 @@ class ReaderState(
 
     private suspend fun loadBookPages(bookId: KomgaBookId): List<PageMetadata> {
         val pages = bookApi.getBookPages(bookId)
+        // page sizes are missing if server hasn't analyzed book yet.
+        // Read sizes of already downloaded pages from image headers so that layout doesn't have to guess them
+        val missingSizePages = pages.filter { it.width == null || it.height == null }.map { it.number }
+        val cachedSizes =
+            if (missingSizePages.isEmpty()) emptyMap()
+            else imageLoader.getCachedPageSizes(bookId, missingSizePages)
 
         return pages.map {
             val width = it.width
@@ -148,7 +156,8 @@ class ReaderState(
             PageMetadata(
                 bookId = bookId,
                 pageNumber = it.number,
-                size = if (width != null && height != null) IntSize(width, height) else null
+                size = if (width != null && height != null) IntSize(width, height)
+                else cachedSizes[it.number]?.let { cached -> IntSize(cached.width, cached.height) }
             )
         }
     }
@@ -79,6 +79,7 @@ class ReaderViewModel(
 
     val readerState: ReaderState = ReaderState(
         bookApi = bookApi,
+        imageLoader = imageLoader,
         seriesApi = seriesApi,
         readListApi = readListApi,
         navigator = navigator,